@@ -6,13 +6,28 @@ mkdir -p build/bin &>/dev/null
 CFLAGS="-Wall -Wextra -O3 -flto -march=native"
 
 clang $CFLAGS -c whisker/cmd/whisker_cmd.c -o build/whisker_cmd.o
+clang $CFLAGS -c whisker/loop/whisker_loop.c -o build/whisker_loop.o
+clang $CFLAGS -c whisker/pool/whisker_pool.c -o build/whisker_pool.o
+clang $CFLAGS -c whisker/lz/whisker_lz.c -o build/whisker_lz.o
+clang $CFLAGS -c whisker/hash/whisker_hash.c -o build/whisker_hash.o
+clang $CFLAGS -c whisker/hash/whisker_hash_generic.c -o build/whisker_hash_generic.o
+clang $CFLAGS -msse2 -c whisker/hash/whisker_hash_sse2.c -o build/whisker_hash_sse2.o
+clang $CFLAGS -mavx2 -c whisker/hash/whisker_hash_avx2.c -o build/whisker_hash_avx2.o
 clang $CFLAGS -c src/config/config.c -o build/config.o
 clang $CFLAGS -c src/config/lexer.c -o build/lexer.o
 clang $CFLAGS -c src/core/build.c -o build/build.o
+clang $CFLAGS -c src/core/cache.c -o build/cache.o
+clang $CFLAGS -c src/core/database.c -o build/database.o
 clang $CFLAGS -c src/core/debug.c -o build/debug.o
+clang $CFLAGS -c src/core/depfile.c -o build/depfile.o
+clang $CFLAGS -c src/core/graph.c -o build/graph.o
 clang $CFLAGS -c src/core/new.c -o build/new.o
 clang $CFLAGS -c src/core/init.c -o build/init.o
+clang $CFLAGS -c src/core/jobserver.c -o build/jobserver.o
+clang $CFLAGS -c src/core/pressure.c -o build/pressure.o
 clang $CFLAGS -c src/core/run.c -o build/run.o
+clang $CFLAGS -c src/core/scheduler.c -o build/scheduler.o
+clang $CFLAGS -c src/core/watch.c -o build/watch.o
 clang $CFLAGS -c src/main.c -o build/main.o
 
 clang $CFLAGS \
@@ -20,9 +35,24 @@ clang $CFLAGS \
     build/config.o \
     build/lexer.o \
     build/build.o \
+    build/cache.o \
+    build/database.o \
+    build/depfile.o \
+    build/graph.o \
     build/new.o \
     build/init.o \
+    build/jobserver.o \
+    build/pressure.o \
     build/run.o  \
+    build/scheduler.o \
+    build/watch.o \
     build/debug.o \
     build/whisker_cmd.o \
-    src/lib/libarena.a -o build/bin/catalyze \
+    build/whisker_loop.o \
+    build/whisker_pool.o \
+    build/whisker_lz.o \
+    build/whisker_hash.o \
+    build/whisker_hash_generic.o \
+    build/whisker_hash_sse2.o \
+    build/whisker_hash_avx2.o \
+    src/lib/libarena.a -lpthread -o build/bin/catalyze \
@@ -109,6 +109,8 @@ static const char* target_type_to_string(TargetType type) {
         case Executable: return "Executable";
         case Debug: return "Debug";
         case Test: return "Test";
+        case StaticLib: return "StaticLib";
+        case SharedLib: return "SharedLib";
         default: return "Unknown";
     }
 }
@@ -128,6 +130,15 @@ void print_target(const Target* target, int indent) {
 
     printf("%*s  ]\n", indent, "");
 
+    printf("%*s  dep_count: %u\n", indent, "", target->dep_count);
+    printf("%*s  deps: [\n", indent, "");
+
+    for (uint8_t i = 0; i < target->dep_count; i++) {
+        printf("%*s    [%u]: %s\n", indent, "", i, target->deps[i]);
+    }
+
+    printf("%*s  ]\n", indent, "");
+
     printf("%*s  source_count: %u\n", indent, "", target->source_count);
     printf("%*s  sources: [\n", indent, "");
 
@@ -144,6 +155,14 @@ void print_catalyze_config(const CatalyzeConfig* config) {
     printf("  compiler: %s\n", config->compiler ? config->compiler : "(null)");
     printf("  build_dir: %s\n", config->build_dir ? config->build_dir : "(null)");
     printf("  prefix: %s\n", config->prefix);
+    printf("  jobs: %u\n", config->jobs);
+    printf("  min_jobs: %u%s\n", config->min_jobs, config->adaptive ? " (adaptive)" : "");
+    printf("  timeout: %u\n", config->timeout);
+    printf("  memory: %luK\n", (unsigned long) config->memory_kb);
+    printf("  cache: %luK\n", (unsigned long) config->cache_kb);
+    printf("  check: %s\n", config->check == CheckContent ? "content" : "mtime");
+    printf("  cache_restore: %s\n", config->cache_restore == RestoreLink ? "link" : "copy");
+    printf("  cache_compress: %s\n", config->cache_compress ? "true" : "false");
 
     printf("  flag_count: %u\n", config->default_flag_count);
     printf("  flags: [\n");
@@ -3,6 +3,7 @@
 
 #include "../utils/arena.h"
 
+#include <stdbool.h>
 #include <stdint.h>
 
 #define MAX_NAME_LEN 64 
@@ -16,6 +17,8 @@
 #define MAX_OUTPUT_DIR_LEN 128
 #define MAX_OUTPUT_NAME_LEN 128
 #define MAX_TARGETS 16
+#define MAX_DEPS MAX_TARGETS
+#define MAX_JOBS 1024
 
 typedef enum {
     Executable,
@@ -25,11 +28,26 @@ typedef enum {
     SharedLib
 } TargetType;
 
+// How the incremental check decides that an input changed
+typedef enum {
+    CheckMtime,
+    CheckContent
+} CheckMode;
+
+// How cache hits are put into the build directory
+typedef enum {
+    RestoreCopy,
+    RestoreLink
+} RestoreMode;
+
 typedef struct {
     char* sources[MAX_SOURCES];
     uint8_t source_count;
     char* flags[MAX_FLAGS];
     uint8_t flag_count;
+    char* deps[MAX_DEPS];
+    uint8_t dep_indices[MAX_DEPS];
+    uint8_t dep_count;
     TargetType type;
     char* name;
     char* output_dir;
@@ -43,6 +61,16 @@ typedef struct {
     char* default_flags[MAX_FLAGS];
     uint8_t default_flag_count;
     uint8_t target_count;
+    uint16_t jobs;
+    uint16_t min_jobs;
+    uint32_t timeout;
+    uint64_t memory_kb;
+    uint64_t cache_kb;
+    bool keep_going;
+    bool adaptive;
+    CheckMode check;
+    RestoreMode cache_restore;
+    bool cache_compress;
     char* compiler;
     char* build_dir;
 } __attribute__((aligned(8))) CatalyzeConfig;
@@ -5,14 +5,32 @@
 #define COMPILER_HASH 0x40116660
 #define BUILD_DIR_HASH 0x19ad88b3
 #define DEFAULT_FLAGS_HASH 0x1825ce76
+#define JOBS_HASH 0x7c9914f3
+#define MIN_JOBS_HASH 0xade86b76
+#define TIMEOUT_HASH 0xe1fe87cc
+#define MEMORY_HASH 0x0d82a8de
+#define CHECK_HASH 0x0f393c43
+#define CACHE_HASH 0x0f355db9
+#define CACHE_RESTORE_HASH 0xbf08a0dc
+#define CACHE_COMPRESS_HASH 0xbbc1bd04
+
+#define MTIME_HASH 0x0ff4d821
+#define CONTENT_HASH 0xd3799980
+#define COPY_HASH 0x7c954020
+#define LINK_HASH 0x7c9a15b3
+#define TRUE_HASH 0x7c9e9fe5
+#define FALSE_HASH 0x0f6bcef0
 
 #define TARGET_HASH 0x1d90fd6c
 #define EXECUTABLE_HASH 0x7c422127
 #define DEBUG_HASH 0x0f49a52c
 #define TEST_HASH 0x7c9e6865
+#define STATIC_LIB_HASH 0x31488b83
+#define SHARED_LIB_HASH 0x183c3bf2
 
 #define SOURCES_HASH 0xa39aeea9
 #define FLAGS_HASH 0x0f71a6d2
 #define OUTPUT_HASH 0x13525d76
+#define DEPS_HASH 0x7c95a1f1
 
 #endif // !CONFIG_HASHES_H
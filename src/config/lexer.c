@@ -15,21 +15,39 @@ static void parse_config_section(Lexer* lexer);
 static void parse_compiler(Lexer* lexer);
 static void parse_build_dir(Lexer* lexer);
 static void parse_default_flags(Lexer* lexer);
+static void parse_jobs(Lexer* lexer);
+static void parse_min_jobs(Lexer* lexer);
+static void parse_timeout(Lexer* lexer);
+static void parse_memory(Lexer* lexer);
+static void parse_check(Lexer* lexer);
+static void parse_cache(Lexer* lexer);
+static void parse_cache_restore(Lexer* lexer);
+static void parse_cache_compress(Lexer* lexer);
 
 static void parse_target_type(Lexer* lexer);
 static void parse_target_name(Lexer* lexer);
 static void parse_sources(Lexer* lexer);
 static void parse_flags(Lexer* lexer);
 static void parse_output(Lexer* lexer);
+static void parse_deps(Lexer* lexer);
 
 static const FieldHandler fields[] = {
     { CONFIG_HASH, parse_config_section }, 
     { COMPILER_HASH, parse_compiler },
     { BUILD_DIR_HASH, parse_build_dir },
     { DEFAULT_FLAGS_HASH, parse_default_flags },
+    { JOBS_HASH, parse_jobs },
+    { MIN_JOBS_HASH, parse_min_jobs },
+    { TIMEOUT_HASH, parse_timeout },
+    { MEMORY_HASH, parse_memory },
+    { CHECK_HASH, parse_check },
+    { CACHE_HASH, parse_cache },
+    { CACHE_RESTORE_HASH, parse_cache_restore },
+    { CACHE_COMPRESS_HASH, parse_cache_compress },
     { SOURCES_HASH, parse_sources },
     { FLAGS_HASH, parse_flags },
     { OUTPUT_HASH, parse_output },
+    { DEPS_HASH, parse_deps },
     { 0, NULL }
 };
 
@@ -231,6 +249,209 @@ static void parse_default_flags(Lexer* lexer) {
     }
 }
 
+static uint64_t parse_number(Lexer* lexer) {
+    skip_whitespace(lexer);
+    char* cursor = lexer -> cursor;
+    char* start = cursor;
+    char* end = lexer -> end;
+
+    uint64_t value = 0;
+    while (*cursor >= '0' && *cursor <= '9') {
+        value = value * 10 + (uint64_t)(*cursor - '0');
+        ADVANCE_CURSOR(cursor, end);
+    }
+
+    if (UNLIKELY(cursor == start || !IS_WHITESPACE(*cursor))) {
+        lexer_err(lexer, "Expected a number!");
+    }
+
+    *cursor = 0;
+    cursor++;
+
+    lexer -> cursor = cursor;
+    return value;
+}
+
+static void parse_jobs(Lexer* lexer) {
+    uint64_t jobs = parse_number(lexer);
+
+    if (UNLIKELY(jobs == 0 || jobs > MAX_JOBS)) {
+        lexer_err(lexer, "Job count must be between 1 and 1024");
+    }
+
+    lexer -> config -> jobs = (uint16_t) jobs;
+}
+
+// Setting a floor turns on adaptive mode, which moves between it and 'jobs' based on system pressure
+static void parse_min_jobs(Lexer* lexer) {
+    uint64_t jobs = parse_number(lexer);
+
+    if (UNLIKELY(jobs == 0 || jobs > MAX_JOBS)) {
+        lexer_err(lexer, "Minimum job count must be between 1 and 1024");
+    }
+
+    lexer -> config -> min_jobs = (uint16_t) jobs;
+    lexer -> config -> adaptive = true;
+}
+
+// Seconds a single compile or link may take before it is killed, 0 disables the limit
+static void parse_timeout(Lexer* lexer) {
+    uint64_t timeout = parse_number(lexer);
+
+    if (UNLIKELY(timeout > UINT32_MAX / 1000)) {
+        lexer_err(lexer, "Timeout is too large");
+    }
+
+    lexer -> config -> timeout = (uint32_t) timeout;
+}
+
+// A size in megabytes, a K/M/G suffix picks the unit. Returns kilobytes.
+static uint64_t parse_size(Lexer* lexer) {
+    skip_whitespace(lexer);
+    char* cursor = lexer -> cursor;
+    char* start = cursor;
+    char* end = lexer -> end;
+
+    uint64_t value = 0;
+    while (*cursor >= '0' && *cursor <= '9') {
+        value = value * 10 + (uint64_t)(*cursor - '0');
+        ADVANCE_CURSOR(cursor, end);
+
+        if (UNLIKELY(value > UINT32_MAX)) {
+            lexer_err(lexer, "Size is too large");
+        }
+    }
+
+    if (UNLIKELY(cursor == start)) {
+        lexer_err(lexer, "Expected a size!");
+    }
+
+    uint64_t kilobytes = value * 1024;
+    switch (*cursor) {
+        case 'K': case 'k': kilobytes = value; ADVANCE_CURSOR(cursor, end); break;
+        case 'M': case 'm': ADVANCE_CURSOR(cursor, end); break;
+        case 'G': case 'g': kilobytes = value * 1024 * 1024; ADVANCE_CURSOR(cursor, end); break;
+    }
+
+    if (UNLIKELY(!IS_WHITESPACE(*cursor))) {
+        lexer_err(lexer, "Expected a size like 512M or 8G!");
+    }
+
+    *cursor = 0;
+    cursor++;
+
+    lexer -> cursor = cursor;
+    return kilobytes;
+}
+
+// Memory budget for concurrently running jobs
+static void parse_memory(Lexer* lexer) {
+    lexer -> config -> memory_kb = parse_size(lexer);
+}
+
+// Size limit of the object cache, setting it turns the cache on
+static void parse_cache(Lexer* lexer) {
+    lexer -> config -> cache_kb = parse_size(lexer);
+}
+
+// 'mtime' trusts timestamps, 'content' only rebuilds when the hash of an input changed
+static void parse_check(Lexer* lexer) {
+    skip_whitespace(lexer);
+    char* cursor = lexer -> cursor;
+    char* start = cursor;
+    char* end = lexer -> end;
+
+    while (IS_ALPHA(*cursor)) {
+        ADVANCE_CURSOR(cursor, end);
+    }
+
+    *cursor = 0;
+    cursor++;
+
+    switch (djb2_hash(start)) {
+        case MTIME_HASH: {
+            lexer -> config -> check = CheckMtime;
+            break;
+        }
+
+        case CONTENT_HASH: {
+            lexer -> config -> check = CheckContent;
+            break;
+        }
+
+        default: {
+            lexer_err(lexer, "Check must be 'mtime' or 'content'");
+        }
+    }
+
+    lexer -> cursor = cursor;
+}
+
+// Hardlinks are opt-in, a cache entry and the object it was restored to share one inode
+static void parse_cache_restore(Lexer* lexer) {
+    skip_whitespace(lexer);
+    char* cursor = lexer -> cursor;
+    char* start = cursor;
+    char* end = lexer -> end;
+
+    while (IS_ALPHA(*cursor)) {
+        ADVANCE_CURSOR(cursor, end);
+    }
+
+    *cursor = 0;
+    cursor++;
+
+    switch (djb2_hash(start)) {
+        case COPY_HASH: {
+            lexer -> config -> cache_restore = RestoreCopy;
+            break;
+        }
+
+        case LINK_HASH: {
+            lexer -> config -> cache_restore = RestoreLink;
+            break;
+        }
+
+        default: {
+            lexer_err(lexer, "Cache restore must be 'copy' or 'link'");
+        }
+    }
+
+    lexer -> cursor = cursor;
+}
+
+static void parse_cache_compress(Lexer* lexer) {
+    skip_whitespace(lexer);
+    char* cursor = lexer -> cursor;
+    char* start = cursor;
+    char* end = lexer -> end;
+
+    while (IS_ALPHA(*cursor)) {
+        ADVANCE_CURSOR(cursor, end);
+    }
+
+    *cursor = 0;
+    cursor++;
+
+    switch (djb2_hash(start)) {
+        case TRUE_HASH: {
+            lexer -> config -> cache_compress = true;
+            break;
+        }
+
+        case FALSE_HASH: {
+            lexer -> config -> cache_compress = false;
+            break;
+        }
+
+        default: {
+            lexer_err(lexer, "Cache compress must be 'true' or 'false'");
+        }
+    }
+
+    lexer -> cursor = cursor;
+}
+
 static void parse_target(Lexer* lexer) {
     skip_whitespace(lexer);
     char* cursor = lexer -> cursor;
@@ -343,6 +564,16 @@ static void parse_target_type(Lexer* lexer) {
             break;
         }
 
+        case STATIC_LIB_HASH: {
+            target -> type = StaticLib;
+            break;
+        }
+
+        case SHARED_LIB_HASH: {
+            target -> type = SharedLib;
+            break;
+        }
+
         default: {
             lexer_err(lexer, "Unknown target type");
         }
@@ -515,6 +746,134 @@ static void parse_output(Lexer* lexer) {
     lexer -> cursor = cursor;
 }
 
+static void parse_deps(Lexer* lexer) {
+    Target* target = &lexer -> config -> targets[lexer -> config -> target_count];
+    target -> dep_count = 0;
+
+    skip_whitespace(lexer);
+    char* cursor = lexer -> cursor;
+
+    if (UNLIKELY(*cursor++ != '[')) {
+        lexer_err(lexer, "Expected '['!");
+    }
+
+    while (IS_WHITESPACE(*cursor)) {
+        cursor++;
+    }
+
+    if (UNLIKELY(*cursor == ']')) {
+        cursor++;
+        lexer -> cursor = cursor;
+        return;
+    }
+
+    while (LIKELY(*cursor != ']')) {
+        if (UNLIKELY(*cursor == 0)) lexer_err(lexer, "Expected ']'!");
+
+        while (IS_WHITESPACE(*cursor)) {
+            cursor++;
+        }
+
+        if (UNLIKELY(*cursor == ']')) {
+            *cursor = 0;
+            cursor++;
+            lexer -> cursor = cursor;
+            return;
+        }
+
+        if (UNLIKELY(target -> dep_count == MAX_DEPS)) {
+            lexer -> cursor = cursor;
+            lexer_err(lexer, "Too many dependencies!");
+        }
+
+        char* dep_start = cursor;
+
+        while (IS_ALPHA(*cursor)) {
+            cursor++;
+        }
+
+        char c = *cursor;
+        *cursor = 0;
+        cursor++;
+        target -> deps[target -> dep_count++] = dep_start;
+
+        if (UNLIKELY(c == ']')) {
+            lexer -> cursor = cursor;
+            return;
+        }
+    }
+}
+
+static void dependency_err(const char* msg, const char* name) {
+    printf("\033[1mError in config.cat:\033[0m %s '%s'\n", msg, name);
+    exit(1);
+}
+
+static void resolve_deps(CatalyzeConfig* config) {
+    for (uint8_t i = 0; i < config -> target_count; i++) {
+        Target* target = &config -> targets[i];
+
+        for (uint8_t d = 0; d < target -> dep_count; d++) {
+            uint8_t index = 0;
+
+            while (index < config -> target_count && strcmp(config -> targets[index].name, target -> deps[d]) != 0) {
+                index++;
+            }
+
+            if (UNLIKELY(index == config -> target_count)) {
+                dependency_err("Unknown dependency", target -> deps[d]);
+            }
+
+            target -> dep_indices[d] = index;
+        }
+    }
+}
+
+typedef enum {
+    Unvisited,
+    Visiting,
+    Visited
+} VisitState;
+
+static void visit_target(const CatalyzeConfig* config, VisitState* states, uint8_t* path, uint8_t depth, uint8_t index) {
+    path[depth] = index;
+
+    if (states[index] == Visiting) {
+        uint8_t start = 0;
+        while (path[start] != index) {
+            start++;
+        }
+
+        printf("\033[1mError in config.cat:\033[0m Dependency cycle: ");
+        for (uint8_t i = start; i < depth; i++) {
+            printf("%s -> ", config -> targets[path[i]].name);
+        }
+
+        printf("%s\n", config -> targets[index].name);
+        exit(1);
+    }
+
+    if (states[index] == Visited) return;
+
+    states[index] = Visiting;
+
+    const Target* target = &config -> targets[index];
+    for (uint8_t d = 0; d < target -> dep_count; d++) {
+        visit_target(config, states, path, depth + 1, target -> dep_indices[d]);
+    }
+
+    states[index] = Visited;
+}
+
+static void check_dependency_cycles(const CatalyzeConfig* config) {
+    VisitState states[MAX_TARGETS] = {0};
+    uint8_t path[MAX_TARGETS + 1];
+
+    for (uint8_t i = 0; i < config -> target_count; i++) {
+        visit_target(config, states, path, 0, i);
+    }
+}
+
 CatalyzeConfig* lexer_parse(ArenaAllocator* arena, char* buffer, const size_t size, const char* prefix, size_t prefix_len) {
     CatalyzeConfig* config = arena_alloc(arena, sizeof(*config));
     memset(config, 0, sizeof(*config));
@@ -551,5 +910,8 @@ CatalyzeConfig* lexer_parse(ArenaAllocator* arena, char* buffer, const size_t si
         parse_target(lexer);
     }
 
+    resolve_deps(config);
+    check_dependency_cycles(config);
+
     return config;
 }
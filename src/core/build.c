@@ -1,27 +1,22 @@
 #include "build.h"
+#include "cache.h"
+#include "database.h"
+#include "graph.h"
+#include "scheduler.h"
 
-// #define DEBUG_MODE
-
-#define WHISKER_NOPREFIX
-#include "../../whisker/cmd/whisker_cmd.h"
+#include "../utils/hash.h"
 #include "../utils/macros.h"
 
 #include <errno.h>
 #include <limits.h>
-#include <pthread.h>
-#include <spawn.h>
+#include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/stat.h>
-#include <sys/wait.h>
 #include <unistd.h>
 
-#define MAX_THREADS 12
-
-extern char** environ;
-
 void build_err(const char* msg) {
     printf("\033[1mError:\033[0m %s\n", msg);
     exit(1);
@@ -57,338 +52,671 @@ inline void make_dir(const char* dir) {
     }
 }
 
-inline const char* source_to_object_name(ArenaAllocator* arena, const char* source_path) {
-    const char* name = strrchr(source_path, '/');
-    name = name ? name + 1 : source_path;
+// src/net/util.c -> <config_dir>/src/net/util.c.o. '.' and 'dir/..' are folded away first, and
+// a source outside the project goes below a directory counting how far up it lives:
+// ../../lib/x.c -> <config_dir>/@up2/lib/x.c.o, /opt/x.c -> <config_dir>/@abs/opt/x.c.o.
+// config.cat paths cannot contain '@', so no project directory collides with them. 'source'
+// gets the folded path of the file compiled.
+static char* object_path(ArenaAllocator* arena, const char* config_dir, const char* source_path, const char** source) {
+    const size_t source_len = strlen(source_path);
+    const bool absolute = source_path[0] == '/';
+
+    char* folded = arena_alloc(arena, source_len + 1);
+    size_t folded_len = 0;
+    uint32_t ups = 0;
+
+    while (*source_path) {
+        const char* end = strchr(source_path, '/');
+        if (end == NULL) end = source_path + strlen(source_path);
+
+        const size_t len = (size_t) (end - source_path);
+
+        if (len == 2 && source_path[0] == '.' && source_path[1] == '.') {
+            // '/..' is '/' again
+            if (folded_len == 0) {
+                ups += !absolute;
+            } else {
+                while (folded_len > 0 && folded[folded_len - 1] != '/') folded_len--;
+                if (folded_len > 0) folded_len--;
+            }
+        } else if (len != 0 && !(len == 1 && source_path[0] == '.')) {
+            if (folded_len != 0) folded[folded_len++] = '/';
 
-    const char* ext = strrchr(name, '.');
-    const size_t len = (size_t)(ext - name);
+            memcpy(folded + folded_len, source_path, len);
+            folded_len += len;
+        }
 
-    char* object_name = arena_alloc(arena, len + 3);
-    strncpy(object_name, name, len);
-    strcpy(object_name + len, ".o");
+        source_path = *end ? end + 1 : end;
+    }
 
-    return object_name;
-}
+    folded[folded_len] = 0;
 
-void link_executable(const char* compiler, const char* output_path, uint8_t source_count, char** all_flags, uint8_t flag_count, char** all_object_files) {
-    Whisker_Cmd cmd = {0};
+    char* canonical = arena_alloc(arena, 3 * ups + folded_len + 2);
+    char* p = canonical;
 
-    cmd_append(&cmd, compiler);
+    if (absolute) {
+        *p++ = '/';
+    }
 
-    for (uint8_t i = 0; i < source_count; i++) {
-        cmd_append(&cmd, all_object_files[i]);
+    for (uint32_t i = 0; i < ups; i++) {
+        memcpy(p, "../", 3);
+        p += 3;
     }
 
-    cmd_append(&cmd, "-o");
+    memcpy(p, folded, folded_len + 1);
+    *source = canonical;
 
-    cmd_append(&cmd, output_path);
+    const size_t size = strlen(config_dir) + folded_len + 32;
+    char* path = arena_alloc(arena, size);
 
-    for (uint8_t i = 0; i < flag_count; i++) {
-        cmd_append(&cmd, all_flags[i]);
+    if (absolute) {
+        snprintf(path, size, "%s/@abs/%s.o", config_dir, folded);
+    } else if (ups != 0) {
+        snprintf(path, size, "%s/@up%u/%s.o", config_dir, ups, folded);
+    } else {
+        snprintf(path, size, "%s/%s.o", config_dir, folded);
     }
 
-    if (!cmd_execute(&cmd)) {
-        build_err("Failed to compile");
-    }
+    return path;
+}
 
-#ifdef DEBUG_MODE
-    cmd_print(&cmd);
-#endif
-    cmd_destroy(&cmd);
+// Identical paths mean the same source compiled the same way, so targets share the compile
+typedef struct {
+    const char* path;
+    const char* source;
+    uint32_t compile;
+    bool planned;
+} PlannedObject;
+
+typedef struct {
+    ArenaAllocator* arena;
+    const CatalyzeConfig* config;
+    BuildGraph graph;
+    BuildDatabase* db;
+    ObjectCache cache;
+    PlannedObject* objects;
+    uint32_t object_mask;
+    bool target_planned[MAX_TARGETS];
+    uint32_t target_links[MAX_TARGETS];
+    char* target_outputs[MAX_TARGETS];
+    char** target_objects[MAX_TARGETS];
+} Planner;
+
+static inline uint32_t resolve_jobs(const CatalyzeConfig* config) {
+    return config -> jobs != 0 ? config -> jobs : scheduler_default_jobs();
 }
 
-void build_project_target(ArenaAllocator* arena, CatalyzeConfig* config, const char* target) {
-    make_dir(config -> build_dir);
+static inline uint32_t hash_path(const char* s) {
+    uint32_t hash = 5381;
+    while (*s) {
+        hash = ((hash << 5) + hash) + *s++;
+    }
+    return hash;
+}
 
-    Target build_target;
-    bool found = false;
+// An absolute 'dir' is taken as is
+static char* prefixed_path(ArenaAllocator* arena, const CatalyzeConfig* config, const char* dir, const char* name) {
+    const size_t prefix_len = dir[0] != '/' ? config -> prefix_len : 0;
+    const size_t dir_len = strlen(dir);
+    const size_t name_len = name ? strlen(name) : 0;
 
-    for (uint8_t i = 0; i < config -> target_count; i++) {
-        if (strcmp(target, config -> targets[i].name) == 0) {
-            build_target = config -> targets[i];
-            found = true;
-            break;
+    char* path = arena_alloc(arena, prefix_len + dir_len + name_len + 2);
+    char* p = path;
+
+    memcpy(p, config -> prefix, prefix_len);
+    p += prefix_len;
+
+    memcpy(p, dir, dir_len);
+    p += dir_len;
+
+    if (name != NULL) {
+        if (dir_len != 0 && dir[dir_len - 1] != '/') {
+            *p++ = '/';
         }
+
+        memcpy(p, name, name_len);
+        p += name_len;
     }
 
-    if (UNLIKELY(found == false)) {
-        build_err("Target not found");
+    *p = 0;
+    return path;
+}
+
+static PlannedObject* find_object(const Planner* planner, const char* object) {
+    uint32_t slot = hash_path(object) & planner -> object_mask;
+
+    while (planner -> objects[slot].path != NULL && strcmp(planner -> objects[slot].path, object) != 0) {
+        slot = (slot + 1) & planner -> object_mask;
     }
 
-    make_dir(config -> build_dir);
+    return &planner -> objects[slot];
+}
 
-    const char* compiler = config -> compiler;
-    const char* path_prefix = config -> prefix;
-    const char* build_dir = config -> build_dir;
-    const size_t prefix_len = config -> prefix_len;
-    const size_t build_dir_len = strlen(build_dir);
-    const char** default_flags = (const char**) config -> default_flags;
-    const uint8_t default_flag_count = config -> default_flag_count;
+// Every target's objects live in a directory named after its compiler and flags, so targets
+// never overwrite each other's objects, and switching flags back finds the old objects again
+static void register_objects(Planner* planner, uint8_t target_index) {
+    const CatalyzeConfig* config = planner -> config;
+    const Target* target = &config -> targets[target_index];
 
-    const char* output_dir = build_target.output_dir;
-    const size_t output_dir_len = strlen(output_dir);
+    uint64_t hash = hash_string(HASH_SEED, config -> compiler);
 
-    const char* output_name = build_target.output_name;
-    const size_t output_name_len = strlen(output_name);
+    for (uint8_t i = 0; i < config -> default_flag_count; i++) {
+        hash = hash_string(hash, config -> default_flags[i]);
+    }
 
-    make_dir(output_dir);
+    for (uint8_t i = 0; i < target -> flag_count; i++) {
+        hash = hash_string(hash, target -> flags[i]);
+    }
 
-    char* output_path = arena_alloc(arena, prefix_len + output_dir_len + output_name_len + 1);
-    char* p = output_path;
+    char name[17];
+    snprintf(name, sizeof(name), "%016llx", (unsigned long long) hash);
 
-    memcpy(p, path_prefix, prefix_len);
-    p += prefix_len;
+    const char* config_dir = prefixed_path(planner -> arena, config, config -> build_dir, name);
+    char** objects = arena_array(planner -> arena, char*, target -> source_count);
 
-    memcpy(p, output_dir, output_dir_len);
-    p += output_dir_len;
+    for (uint8_t i = 0; i < target -> source_count; i++) {
+        const char* source = NULL;
+        objects[i] = object_path(planner -> arena, config_dir, target -> sources[i], &source);
 
-    *p++ = '/';
+        PlannedObject* object = find_object(planner, objects[i]);
 
-    memcpy(p, output_name, output_name_len);
-    p += output_name_len;
+        if (object -> path == NULL) {
+            object -> path = objects[i];
+            object -> source = source;
+            object -> compile = NO_JOB;
+        } else if (UNLIKELY(strcmp(object -> source, source) != 0)) {
+            // Sharing the compile would leave one of them unbuilt, so refuse rather than guess
+            printf("\033[1mError:\033[0m %s and %s both compile to %s\n", object -> source, source, objects[i]);
+            exit(1);
+        }
+    }
 
-    *p = 0;
+    planner -> target_objects[target_index] = objects;
+}
+
+static void init_planner(Planner* planner, ArenaAllocator* arena, const CatalyzeConfig* config, BuildDatabase* db) {
+    uint32_t source_total = 0;
+    for (uint8_t i = 0; i < config -> target_count; i++) {
+        source_total += config -> targets[i].source_count;
+    }
+
+    uint32_t capacity = 16;
+    while (capacity < source_total * 2) {
+        capacity <<= 1;
+    }
+
+    planner -> arena = arena;
+    planner -> config = config;
+    planner -> db = db;
+    planner -> objects = arena_array_zero(arena, PlannedObject, capacity);
+    planner -> object_mask = capacity - 1;
+
+    for (uint8_t i = 0; i < MAX_TARGETS; i++) {
+        planner -> target_planned[i] = false;
+        planner -> target_links[i] = NO_JOB;
+        planner -> target_outputs[i] = NULL;
+    }
 
-    const uint8_t source_count = build_target.source_count;
-    char** original_sources = build_target.sources;
-    char** sources = arena_alloc(arena, source_count * sizeof(char*));
+    for (uint8_t i = 0; i < config -> target_count; i++) {
+        register_objects(planner, i);
+    }
+
+    graph_init(arena, &planner -> graph, source_total + config -> target_count);
 
-    for (int i = 0; i < source_count; i++ ){
-        const char* source = original_sources[i];
-        const size_t source_len = strlen(source);
-        const size_t total_len = prefix_len + source_len + 1;
+    database_hash_files(db, resolve_jobs(config));
+    cache_open(arena, &planner -> cache, config);
+}
 
-        char* source_path = arena_alloc(arena, total_len);
-        char* p = source_path;
+// Only objects that get compiled need their directory, most of them are usually up to date
+static void make_object_dir(const char* object) {
+    char dir[PATH_MAX];
+    const char* slash = strrchr(object, '/');
 
-        memcpy(p, path_prefix, prefix_len);
-        p += prefix_len;
+    snprintf(dir, sizeof(dir), "%.*s", (int) (slash - object), object);
+    make_dir(dir);
+}
 
-        memcpy(p, source, source_len);
-        p += source_len;
-        *p = 0;
+static inline bool is_newer(const struct timespec* a, const struct timespec* b) {
+    return a -> tv_sec != b -> tv_sec ? a -> tv_sec > b -> tv_sec : a -> tv_nsec > b -> tv_nsec;
+}
 
-        sources[i] = source_path;
+static inline bool input_changed(BuildDatabase* db, uint32_t input, const struct timespec* output_mtime) {
+    struct timespec mtime;
+    return !database_mtime(db, input, &mtime) || is_newer(&mtime, output_mtime);
+}
+
+// Missing outputs and outputs older than any input need rebuilding, a missing input too,
+// so the compiler gets to report it. The database caches every stat for the whole build.
+static bool is_stale(BuildDatabase* db, const char* output, char* const* inputs, uint32_t input_count) {
+    struct timespec output_mtime;
+    if (!database_mtime(db, database_intern(db, output), &output_mtime)) return true;
+
+    for (uint32_t i = 0; i < input_count; i++) {
+        if (input_changed(db, database_intern(db, inputs[i]), &output_mtime)) {
+            return true;
+        }
     }
-    
-    const uint8_t flag_count = build_target.flag_count;
-    const uint8_t all_flag_count = default_flag_count + flag_count;
 
-    char** all_flags = arena_alloc(arena, all_flag_count * sizeof(char*));
-    memcpy(all_flags, default_flags, sizeof(char*) * default_flag_count);
-    memcpy(all_flags + default_flag_count, build_target.flags, sizeof(char*) * flag_count);
+    return false;
+}
 
-    char** all_object_files = arena_array(arena, char*, source_count);
+// build/<config>/src/main.c.o -> build/<config>/src/main.c.d
+static char* object_sibling(ArenaAllocator* arena, const char* object, char extension) {
+    const size_t len = strlen(object);
 
-    for (int i = 0; i < source_count; i++) {
-        const char* temp = source_to_object_name(arena, sources[i]);
-        const size_t temp_len = strlen(temp);
-        const size_t total_len = build_dir_len + prefix_len + temp_len + 1;
+    char* sibling = arena_alloc(arena, len + 1);
+    memcpy(sibling, object, len + 1);
+    sibling[len - 1] = extension;
 
-        char* obj_path = arena_alloc(arena, total_len);
-        char* p = obj_path;
+    return sibling;
+}
 
-        memcpy(p, path_prefix, prefix_len);
-        p += prefix_len;
+// The record describing the output on disk, as long as it was built by this exact command.
+// An output without one, built before the database existed, by other flags or rewritten
+// behind its back, has to be rebuilt. In content mode a touched or restored output whose
+// bytes are still the ones recorded counts as well.
+static const DatabaseRecord* current_record(BuildDatabase* db, const char* output, char* const* argv, struct timespec* mtime) {
+    const uint32_t id = database_intern(db, output);
+    if (!database_mtime(db, id, mtime)) return NULL;
 
-        memcpy(p, build_dir, build_dir_len);
-        p += build_dir_len;
+    const DatabaseRecord* record = database_find(db, output);
+    const int64_t mtime_ns = (int64_t) mtime -> tv_sec * 1000000000ll + mtime -> tv_nsec;
 
-        memcpy(p, temp, temp_len);
-        p[temp_len] = 0;
+    if (record == NULL || record -> command_hash != database_hash_command(db, argv)) {
+        return NULL;
+    }
 
-        all_object_files[i] = obj_path;
+    if (record -> output_mtime_ns != mtime_ns && !(db -> content && database_content_hash(db, id) == record -> output_hash)) {
+        return NULL;
     }
 
-    char* argv[5 + all_flag_count];
-    argv[0] = (char*) compiler;
-    argv[1] = "-c";
-    argv[2] = NULL;
-    argv[3] = "-o";
-    argv[4] = NULL;
+    return record;
+}
+
+// Content mode ignores timestamps, the inputs are stale once they hash differently.
+// Records written in mtime mode carry no input hash and are still checked by mtime.
+static inline bool check_content(const BuildDatabase* db, const DatabaseRecord* record) {
+    return db -> content && record -> input_hash != 0;
+}
 
-    for (size_t j = 0; j < all_flag_count; j++) {
-        argv[j + 5] = all_flags[j];
-    } 
+static inline bool inputs_changed(BuildDatabase* db, const DatabaseRecord* record) {
+    return database_input_hash(db, record -> inputs, record -> input_count) != record -> input_hash;
+}
 
-    argv[5 + all_flag_count] = NULL;
+// The record lists the source and every header the object was built from
+static bool is_compile_stale(Planner* planner, const char* object, char* const* argv) {
+    BuildDatabase* db = planner -> db;
 
-    int idx = 0;
-    pid_t pids[MAX_THREADS];
+    struct timespec object_mtime;
+    const DatabaseRecord* record = current_record(db, object, argv, &object_mtime);
 
-    while (LIKELY(idx < source_count)) {
-        int batch_size = (source_count - idx > MAX_THREADS) ? MAX_THREADS : (source_count - idx);
+    if (record == NULL || record -> input_count == 0) return true;
+    if (check_content(db, record)) return inputs_changed(db, record);
 
-        for (int i = 0; i < batch_size; i++) {
-            argv[2] = (char*) sources[idx];
-            argv[4] = all_object_files[idx];
-            posix_spawnp(&pids[i], argv[0], NULL, NULL, argv, environ);
-            idx++;
+    for (uint32_t i = 0; i < record -> input_count; i++) {
+        if (input_changed(db, record -> inputs[i], &object_mtime)) {
+            return true;
         }
+    }
 
-        for (int i = 0; i < batch_size; i++) {
-            int status;
-            if (UNLIKELY(waitpid(pids[i], &status, 0) < 0)) {
-                build_err("Build failure");
-            }
+    return false;
+}
 
-            if (UNLIKELY(!WIFEXITED(status)) || WEXITSTATUS(status) != 0) {
-                build_err("Compilation failed");
-            }
-        }
+// Direct mode, the files the object was last compiled from may still name a cached object.
+// The job then only copies it, falling back to 'cc -E' when the copy fails.
+static void plan_direct(Planner* planner, Job* job) {
+    BuildDatabase* db = planner -> db;
+
+    const DatabaseRecord* record = database_find(db, job -> output);
+    if (record == NULL || record -> input_count == 0) return;
+
+    if (!cache_lookup_direct(&planner -> cache, db, job -> argv, record -> inputs, record -> input_count, &job -> cache_key)) return;
+
+    job -> inputs = arena_array(planner -> arena, char*, record -> input_count);
+    job -> input_count = record -> input_count;
+    job -> direct = true;
+
+    for (uint32_t i = 0; i < record -> input_count; i++) {
+        job -> inputs[i] = (char*) database_path(db, record -> inputs[i]);
+    }
+}
+
+static inline bool is_library(TargetType type) {
+    return type == StaticLib || type == SharedLib;
+}
+
+// Reverse postorder over the dependency tree, so every library comes before the
+// libraries it depends on, which is the order static linking needs
+static void collect_libraries(const Planner* planner, const Target* target, bool* seen, uint8_t* libraries, uint8_t* count) {
+    const CatalyzeConfig* config = planner -> config;
 
-        switch (build_target.type) {
-            case Executable:
-            case Debug:
-            case Test:
-                link_executable(compiler, output_path, source_count, all_flags, all_flag_count, all_object_files);
-                break;
+    for (uint8_t d = target -> dep_count; d-- > 0;) {
+        const uint8_t index = target -> dep_indices[d];
+        if (seen[index]) continue;
 
-            default:
-                build_err("Unknown target");
+        seen[index] = true;
+        collect_libraries(planner, &config -> targets[index], seen, libraries, count);
+
+        if (is_library(config -> targets[index].type)) {
+            libraries[(*count)++] = index;
         }
     }
 }
 
-void build_project_all(ArenaAllocator* arena, CatalyzeConfig* config) {
-    make_dir(config -> build_dir);
-
-    const char* compiler = config -> compiler;
-    const char* path_prefix = config -> prefix;
-    const char* build_dir = config -> build_dir;
-    const size_t prefix_len = config -> prefix_len;
-    const size_t build_dir_len = strlen(build_dir);
-    const char** default_flags = (const char**) config -> default_flags;
-    const uint8_t default_flag_count = config -> default_flag_count;
+static bool is_direct_dep(const Target* target, uint8_t index) {
+    for (uint8_t d = 0; d < target -> dep_count; d++) {
+        if (target -> dep_indices[d] == index) return true;
+    }
 
-    for (uint8_t current_target = 0; current_target < config -> target_count; current_target++) {
-        Target build_target = config -> targets[current_target];
-        if (build_target.type != Executable) continue;
+    return false;
+}
 
-        const char* output_dir = build_target.output_dir;
-        const size_t output_dir_len = strlen(output_dir);
+// Returns NO_JOB when nothing was rebuilt upstream and no input changed since the output was linked
+static uint32_t link_executable(Planner* planner, const Target* target, const char* output_path, uint8_t source_count, char** all_object_files, const uint32_t* compiles, uint8_t flag_count, char** all_flags, bool inputs_rebuilt) {
+    bool seen[MAX_TARGETS] = {0};
+    uint8_t library_targets[MAX_TARGETS];
+    char* libraries[MAX_TARGETS];
+    uint8_t library_count = 0;
 
-        const char* output_name = build_target.output_name;
-        const size_t output_name_len = strlen(output_name);
+    if (target -> type != StaticLib) {
+        collect_libraries(planner, target, seen, library_targets, &library_count);
+    }
 
-        make_dir(output_dir);
+    for (uint8_t i = 0; i < library_count; i++) {
+        libraries[i] = planner -> target_outputs[library_targets[i]];
+    }
 
-        char* output_path = arena_alloc(arena, prefix_len + output_dir_len + output_name_len + 2);
-        char* p = output_path;
+    char** argv = arena_array(planner -> arena, char*, 6 + source_count + library_count + flag_count);
+    char** p = argv;
 
-        memcpy(p, path_prefix, prefix_len);
-        p += prefix_len;
+    if (target -> type == StaticLib) {
+        *p++ = "ar";
+        *p++ = "rcs";
+        *p++ = (char*) output_path;
 
-        memcpy(p, output_dir, output_dir_len);
-        p += output_dir_len;
+        memcpy(p, all_object_files, sizeof(char*) * source_count);
+        p += source_count;
+    } else {
+        *p++ = planner -> config -> compiler;
 
-        *p++ = '/';
+        if (target -> type == SharedLib) {
+            *p++ = "-shared";
+        }
 
-        memcpy(p, output_name, output_name_len);
-        p += output_name_len;
+        memcpy(p, all_object_files, sizeof(char*) * source_count);
+        p += source_count;
 
-        *p = 0;
+        for (uint8_t i = library_count; i-- > 0;) {
+            *p++ = libraries[i];
+        }
 
-        const uint8_t source_count = build_target.source_count;
-        char** original_sources = build_target.sources;
-        char** sources = arena_alloc(arena, source_count * sizeof(char*));
+        *p++ = "-o";
+        *p++ = (char*) output_path;
 
-        for (int i = 0; i < source_count; i++ ){
-            const char* source = original_sources[i];
-            const size_t source_len = strlen(source);
-            const size_t total_len = prefix_len + source_len + 1;
+        memcpy(p, all_flags, sizeof(char*) * flag_count);
+        p += flag_count;
+    }
+
+    *p = NULL;
+
+    char** inputs = arena_array(planner -> arena, char*, source_count + library_count);
+    memcpy(inputs, all_object_files, sizeof(char*) * source_count);
+    memcpy(inputs + source_count, libraries, sizeof(char*) * library_count);
+
+    BuildDatabase* db = planner -> db;
+    struct timespec output_mtime;
+    const DatabaseRecord* record = current_record(db, output_path, argv, &output_mtime);
+
+    if (record != NULL && !inputs_rebuilt && !(check_content(db, record) ? inputs_changed(db, record) : is_stale(db, output_path, inputs, source_count + library_count))) {
+        return NO_JOB;
+    }
 
-            char* source_path = arena_alloc(arena, total_len);
-            char* p = source_path;
+    const uint32_t link = graph_add_job(planner -> arena, &planner -> graph, JobLink, argv, output_path);
+    Job* job = &planner -> graph.jobs[link];
 
-            memcpy(p, path_prefix, prefix_len);
-            p += prefix_len;
+    job -> inputs = inputs;
+    job -> input_count = source_count + library_count;
 
-            memcpy(p, source, source_len);
-            p += source_len;
-            *p = 0;
+    // Early cutoff: when the rebuilt inputs come out byte-identical the link is skipped at run
+    // time, so everything that is not rebuilt has to be current already. Content mode compares
+    // the inputs' hashes once they are rebuilt instead.
+    job -> cutoff = record != NULL;
 
-            sources[i] = source_path;
+    if (job -> cutoff && !check_content(db, record)) {
+        for (uint8_t i = 0; i < source_count && job -> cutoff; i++) {
+            job -> cutoff = compiles[i] != NO_JOB || !input_changed(db, database_intern(db, all_object_files[i]), &output_mtime);
         }
 
-        const uint8_t flag_count = build_target.flag_count;
-        const uint8_t all_flag_count = default_flag_count + flag_count;
+        for (uint8_t i = 0; i < library_count && job -> cutoff; i++) {
+            job -> cutoff = planner -> target_links[library_targets[i]] != NO_JOB || !input_changed(db, database_intern(db, libraries[i]), &output_mtime);
+        }
+    }
+
+    // Indirect libraries are linked in as well, so their rebuilds have to reach this link directly
+    for (uint8_t i = 0; i < library_count; i++) {
+        const uint32_t library_link = planner -> target_links[library_targets[i]];
+
+        if (library_link != NO_JOB && !is_direct_dep(target, library_targets[i])) {
+            graph_add_edge(planner -> arena, &planner -> graph, library_link, link);
+        }
+    }
+
+    return link;
+}
+
+// Returns the target's link job, NO_JOB when the target is already up to date
+static uint32_t plan_target(Planner* planner, uint8_t target_index) {
+    if (planner -> target_planned[target_index]) {
+        return planner -> target_links[target_index];
+    }
+
+    planner -> target_planned[target_index] = true;
+
+    ArenaAllocator* arena = planner -> arena;
+    const CatalyzeConfig* config = planner -> config;
+    const Target* build_target = &config -> targets[target_index];
+
+    uint32_t dep_links[MAX_DEPS];
+    bool inputs_rebuilt = false;
+
+    for (uint8_t d = 0; d < build_target -> dep_count; d++) {
+        dep_links[d] = plan_target(planner, build_target -> dep_indices[d]);
+        inputs_rebuilt |= dep_links[d] != NO_JOB;
+    }
 
-        char** all_flags = arena_alloc(arena, all_flag_count * sizeof(char*));
-        memcpy(all_flags, default_flags, sizeof(char*) * default_flag_count);
-        memcpy(all_flags + default_flag_count, build_target.flags, sizeof(char*) * flag_count);
+    make_dir(prefixed_path(arena, config, build_target -> output_dir, NULL));
 
-        char** all_object_files = arena_array(arena, char*, build_target.source_count);
+    char* output_path = prefixed_path(arena, config, build_target -> output_dir, build_target -> output_name);
+    planner -> target_outputs[target_index] = output_path;
 
-        for (int i = 0; i < source_count; i++) {
-            const char* temp = source_to_object_name(arena, sources[i]);
-            const size_t temp_len = strlen(temp);
-            const size_t total_len = build_dir_len + prefix_len + temp_len + 1;
+    const uint8_t default_flag_count = config -> default_flag_count;
+    const uint8_t flag_count = build_target -> flag_count;
+    const uint8_t all_flag_count = default_flag_count + flag_count;
 
-            char* obj_path = arena_alloc(arena, total_len);
-            char* p = obj_path;
+    char** all_flags = arena_array(arena, char*, all_flag_count);
+    memcpy(all_flags, config -> default_flags, sizeof(char*) * default_flag_count);
+    memcpy(all_flags + default_flag_count, build_target -> flags, sizeof(char*) * flag_count);
 
-            memcpy(p, path_prefix, prefix_len);
-            p += prefix_len;
-            
-            memcpy(p, build_dir, build_dir_len);
-            p += build_dir_len;
+    const uint8_t source_count = build_target -> source_count;
+    char** all_object_files = planner -> target_objects[target_index];
+    uint32_t compiles[MAX_SOURCES];
 
-            memcpy(p, temp, temp_len);
-            p += temp_len;
-            *p = 0;
+    for (uint8_t i = 0; i < source_count; i++) {
+        PlannedObject* object = find_object(planner, all_object_files[i]);
 
-            all_object_files[i] = obj_path;
+        // Already planned for a target with the same flags, which is either up to date or runs once for both
+        if (object -> planned) {
+            compiles[i] = object -> compile;
+            inputs_rebuilt |= compiles[i] != NO_JOB;
+            continue;
         }
 
-        char* argv[5 + all_flag_count];
-        argv[0] = (char*) compiler;
+        object -> planned = true;
+
+        char* depfile = object_sibling(arena, all_object_files[i], 'd');
+
+        char** argv = arena_array(arena, char*, 9 + all_flag_count);
+        argv[0] = config -> compiler;
         argv[1] = "-c";
-        argv[2] = NULL;
+        argv[2] = prefixed_path(arena, config, build_target -> sources[i], NULL);
         argv[3] = "-o";
-        argv[4] = NULL;
+        argv[4] = all_object_files[i];
+        argv[5] = "-MMD";
+        argv[6] = "-MF";
+        argv[7] = depfile;
 
-        for (size_t j = 0; j < all_flag_count; j++) {
-            argv[j + 5] = all_flags[j];
-        } 
-        
-        argv[5 + all_flag_count] = NULL;
+        memcpy(argv + 8, all_flags, sizeof(char*) * all_flag_count);
+        argv[8 + all_flag_count] = NULL;
 
-        int idx = 0;
-        pid_t pids[MAX_THREADS];
+        if (!is_compile_stale(planner, all_object_files[i], argv)) {
+            compiles[i] = NO_JOB;
+            continue;
+        }
 
-        while (LIKELY(idx < source_count)) {
-            int batch_size = (source_count - idx > MAX_THREADS) ? MAX_THREADS : (source_count - idx);
+        compiles[i] = graph_add_job(arena, &planner -> graph, JobCompile, argv, all_object_files[i]);
+        object -> compile = compiles[i];
+        make_object_dir(all_object_files[i]);
+        planner -> graph.jobs[compiles[i]].depfile = depfile;
+        inputs_rebuilt = true;
 
-            for (int i = 0; i < batch_size; i++) {
-                argv[2] = (char*) sources[idx];
-                argv[4] = all_object_files[idx];
-                posix_spawnp(&pids[i], argv[0], NULL, NULL, argv, environ);
-                idx++;
-            }
+        // With a cache the job starts as 'cc -E', which also writes the depfile, and only compiles on a miss
+        if (planner -> cache.enabled) {
+            Job* job = &planner -> graph.jobs[compiles[i]];
+            char** preprocess_argv = arena_array(arena, char*, 9 + all_flag_count);
 
-            for (int i = 0; i < batch_size; i++) {
-                int status;
-                if (UNLIKELY(waitpid(pids[i], &status, 0) < 0)) {
-                    build_err("Build failure");
-                }
+            memcpy(preprocess_argv, argv, sizeof(char*) * (9 + all_flag_count));
+            job -> preprocessed = object_sibling(arena, all_object_files[i], 'i');
+            preprocess_argv[1] = "-E";
+            preprocess_argv[4] = (char*) job -> preprocessed;
 
-                if (UNLIKELY(!WIFEXITED(status)) || WEXITSTATUS(status) != 0) {
-                    build_err("Compilation failed");
-                }
-            }
+            job -> preprocess_argv = preprocess_argv;
+            job -> preprocessing = true;
+
+            plan_direct(planner, job);
         }
+    }
+
+    const uint32_t link = link_executable(planner, build_target, output_path, source_count, all_object_files, compiles, all_flag_count, all_flags, inputs_rebuilt);
+    planner -> target_links[target_index] = link;
 
-        switch (build_target.type) {
-            case Executable:
-            case Debug:
-            case Test:
-                link_executable(compiler, output_path, source_count, all_flags, all_flag_count, all_object_files);
-                break;
+    if (link == NO_JOB) return NO_JOB;
 
-            default:
-                build_err("Unknown target");
+    for (uint8_t d = 0; d < build_target -> dep_count; d++) {
+        if (dep_links[d] != NO_JOB) {
+            graph_add_edge(arena, &planner -> graph, dep_links[d], link);
         }
     }
+
+    for (uint8_t i = 0; i < source_count; i++) {
+        if (compiles[i] == NO_JOB) continue;
+
+        graph_add_edge(arena, &planner -> graph, compiles[i], link);
+    }
+
+    return link;
+}
+
+void build_open_database(ArenaAllocator* arena, const CatalyzeConfig* config, BuildDatabase* db) {
+    make_dir(prefixed_path(arena, config, config -> build_dir, NULL));
+    database_open(arena, db, config);
+}
+
+static bool run_planner(Planner* planner) {
+    if (planner -> graph.count == 0) {
+        cache_close(&planner -> cache);
+        printf("Nothing to do, all targets are up to date\n");
+        return true;
+    }
+
+    const SchedulerOptions options = {
+        .max_jobs = resolve_jobs(planner -> config),
+        .min_jobs = planner -> config -> min_jobs,
+        .timeout_ms = planner -> config -> timeout * 1000,
+        .memory_kb = planner -> config -> memory_kb != 0 ? planner -> config -> memory_kb : scheduler_default_memory(),
+        .keep_going = planner -> config -> keep_going,
+        .adaptive = planner -> config -> adaptive,
+    };
+
+    const bool succeeded = scheduler_run(planner -> arena, &planner -> graph, &options, planner -> db, &planner -> cache);
+    cache_close(&planner -> cache);
+
+    return succeeded;
+}
+
+static uint8_t find_target(const CatalyzeConfig* config, const char* target) {
+    uint8_t target_index = 0;
+
+    while (target_index < config -> target_count && strcmp(target, config -> targets[target_index].name) != 0) {
+        target_index++;
+    }
+
+    if (UNLIKELY(target_index == config -> target_count)) {
+        build_err("Target not found");
+    }
+
+    return target_index;
+}
+
+// Plans every buildable target when 'target_count' is 0. All of them go into one graph, so
+// targets sharing dependencies or objects plan them once and a single scheduler run covers all.
+static void plan_targets(Planner* planner, const char* const* targets, uint8_t target_count) {
+    const CatalyzeConfig* config = planner -> config;
+
+    for (uint8_t i = 0; i < target_count; i++) {
+        plan_target(planner, find_target(config, targets[i]));
+    }
+
+    if (target_count != 0) return;
+
+    for (uint8_t i = 0; i < config -> target_count; i++) {
+        const TargetType type = config -> targets[i].type;
+        if (type != Executable && !is_library(type)) continue;
+
+        plan_target(planner, i);
+    }
+}
+
+static void build_once(ArenaAllocator* arena, CatalyzeConfig* config, const char* const* targets, uint8_t target_count) {
+    BuildDatabase db;
+    build_open_database(arena, config, &db);
+
+    Planner planner;
+    init_planner(&planner, arena, config, &db);
+    plan_targets(&planner, targets, target_count);
+
+    const bool succeeded = run_planner(&planner);
+    database_close(&db);
+
+    if (UNLIKELY(!succeeded)) {
+        exit(1);
+    }
+}
+
+void build_project_targets(ArenaAllocator* arena, CatalyzeConfig* config, const char* const* targets, uint8_t target_count) {
+    // A misspelled name fails before anything is opened or planned
+    for (uint8_t i = 0; i < target_count; i++) {
+        find_target(config, targets[i]);
+    }
+
+    build_once(arena, config, targets, target_count);
+}
+
+void build_project_all(ArenaAllocator* arena, CatalyzeConfig* config) {
+    build_once(arena, config, NULL, 0);
+}
+
+bool build_project_watched(ArenaAllocator* arena, const CatalyzeConfig* config, BuildDatabase* db, const char* target) {
+    Planner planner;
+    init_planner(&planner, arena, config, db);
+    plan_targets(&planner, &target, target != NULL);
+
+    const bool succeeded = run_planner(&planner);
+
+    // Failed and cancelled jobs may have left their output half-written or deleted it, and the
+    // next plan must see what is actually on disk
+    for (uint32_t i = 0; i < planner.graph.count; i++) {
+        database_forget(db, database_intern(db, planner.graph.jobs[i].output));
+    }
+
+    return succeeded;
 }
@@ -1,10 +1,13 @@
 #ifndef BUILD_H
 #define BUILD_H
 
+#include "database.h"
+
 #include "../config/config.h"
 
 #include "../utils/arena.h"
 
+#include <stdbool.h>
 #include <stdint.h>
 
 typedef struct {
@@ -19,9 +22,15 @@ typedef struct {
     char* compiler;
 } Arg;
 
-void build_project_target(ArenaAllocator* arena, CatalyzeConfig* config, const char* target);
+// Builds the named targets together, planned into one graph and run by one scheduler
+void build_project_targets(ArenaAllocator* arena, CatalyzeConfig* config, const char* const* targets, uint8_t target_count);
 void build_project_all(ArenaAllocator* arena, CatalyzeConfig* config);
 
+// For 'catalyze watch', which keeps one database open, and with it every cached stat, across
+// builds. A NULL target builds all of them. Returns false on a failed build instead of exiting.
+void build_open_database(ArenaAllocator* arena, const CatalyzeConfig* config, BuildDatabase* db);
+bool build_project_watched(ArenaAllocator* arena, const CatalyzeConfig* config, BuildDatabase* db, const char* target);
+
 void make_dir(const char* dir); 
 
 #endif // !BUILD_H
@@ -0,0 +1,695 @@
+#define _GNU_SOURCE
+
+#include "cache.h"
+
+#include "../utils/hash.h"
+#include "../utils/macros.h"
+
+#define WHISKER_NOPREFIX
+#include "../../whisker/hash/whisker_hash.h"
+#include "../../whisker/lz/whisker_lz.h"
+
+#include <dirent.h>
+#include <linux/fs.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/file.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#define CACHE_STATS_FILE "stats"
+#define CACHE_TEMP_PREFIX "tmp."
+#define CACHE_EVICT_PERCENT 90
+#define CACHE_TEMP_MAX_AGE_NS (3600ll * 1000000000ll)
+
+// "CLZ1", an object file starts with its ELF magic instead
+#define CACHE_PACKED_MAGIC 0x315a4c43u
+#define CACHE_BLOCK_STORED 0x80000000u
+
+// A compressed entry is this header and then per block a length word, a check word (the low half
+// of the block's hash) and its bytes. Blocks that do not shrink are stored as they are, marked by
+// the top bit of the length word.
+typedef struct {
+    uint32_t magic;
+    uint32_t block_size;
+    uint64_t size;
+} PackedHeader;
+
+typedef struct {
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t size;
+    uint64_t reserved;
+} CacheStats;
+
+typedef struct {
+    char* path;
+    int64_t used_ns;
+    uint64_t size;
+} CacheFile;
+
+static void* grow(ArenaAllocator* arena, void* ptr, const size_t old_size, const size_t new_size) {
+    void* result = arena_alloc(arena, new_size);
+
+    if (old_size != 0) {
+        arena_memcpy(result, ptr, old_size);
+    }
+
+    return result;
+}
+
+static inline int64_t timespec_ns(const struct timespec* ts) {
+    return (int64_t) ts -> tv_sec * 1000000000ll + ts -> tv_nsec;
+}
+
+static const char* cache_root(ArenaAllocator* arena) {
+    const char* xdg = getenv("XDG_CACHE_HOME");
+    const char* home = getenv("HOME");
+    char buffer[PATH_MAX];
+
+    if (xdg != NULL && xdg[0] == '/') {
+        snprintf(buffer, sizeof(buffer), "%s/catalyze", xdg);
+    } else if (home != NULL && home[0] != 0) {
+        snprintf(buffer, sizeof(buffer), "%s/.cache/catalyze", home);
+    } else {
+        return NULL;
+    }
+
+    const size_t len = strlen(buffer);
+    char* root = arena_alloc(arena, len + 1);
+    memcpy(root, buffer, len + 1);
+
+    return root;
+}
+
+// mkdir -p, false when the directory cannot be created
+static bool make_dirs(const char* dir) {
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), "%s", dir);
+
+    for (char* p = path + 1; *p; p++) {
+        if (*p != '/') continue;
+
+        *p = 0;
+        if (mkdir(path, 0755) != 0 && errno != EEXIST) return false;
+        *p = '/';
+    }
+
+    return mkdir(path, 0755) == 0 || errno == EEXIST;
+}
+
+// The compiler is told apart by where it lives, its size and its mtime, so an upgrade
+// starts from an empty cache without running it
+static uint64_t compiler_identity(const char* compiler) {
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), "%s", compiler);
+
+    const char* search = getenv("PATH");
+
+    if (strchr(compiler, '/') == NULL && search != NULL) {
+        while (*search) {
+            const char* end = strchr(search, ':');
+            const size_t len = end != NULL ? (size_t) (end - search) : strlen(search);
+
+            snprintf(path, sizeof(path), "%.*s/%s", (int) len, search, compiler);
+            if (access(path, X_OK) == 0) break;
+
+            snprintf(path, sizeof(path), "%s", compiler);
+            search += len + (end != NULL);
+        }
+    }
+
+    uint64_t hash = hash_string(HASH_SEED, path);
+    struct stat st;
+
+    if (stat(path, &st) == 0) {
+        const int64_t mtime_ns = timespec_ns(&st.st_mtim);
+        hash = hash_bytes(hash, &st.st_size, sizeof(st.st_size));
+        hash = hash_bytes(hash, &mtime_ns, sizeof(mtime_ns));
+    }
+
+    return hash;
+}
+
+void cache_open(ArenaAllocator* arena, ObjectCache* cache, const CatalyzeConfig* config) {
+    cache -> arena = arena;
+    cache -> dir = NULL;
+    cache -> limit = config -> cache_kb * 1024;
+    cache -> compiler_hash = 0;
+    cache -> stored_bytes = 0;
+    cache -> hits = 0;
+    cache -> direct_hits = 0;
+    cache -> misses = 0;
+    cache -> stores = 0;
+    cache -> packed_in = 0;
+    cache -> packed_out = 0;
+    cache -> unpacked_bytes = 0;
+    cache -> unpack_ns = 0;
+    cache -> link = config -> cache_restore == RestoreLink;
+    cache -> compress = config -> cache_compress;
+    cache -> enabled = false;
+
+    if (config -> cache_kb == 0) return;
+
+    cache -> dir = cache_root(arena);
+
+    // Without a usable cache directory every compile simply runs
+    if (UNLIKELY(cache -> dir == NULL || !make_dirs(cache -> dir))) return;
+
+    cache -> compiler_hash = compiler_identity(config -> compiler);
+    cache -> enabled = true;
+}
+
+static bool write_all(int fd, const void* data, size_t size) {
+    for (size_t written = 0; written < size;) {
+        const ssize_t w = write(fd, (const char*) data + written, size - written);
+
+        if (w < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+
+        written += (size_t) w;
+    }
+
+    return true;
+}
+
+// Fills the buffer unless the file ends first, -1 on an error
+static ssize_t read_all(int fd, void* buffer, size_t size) {
+    size_t total = 0;
+
+    while (total < size) {
+        const ssize_t n = read(fd, (char*) buffer + total, size - total);
+
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+
+        if (n == 0) break;
+        total += (size_t) n;
+    }
+
+    return (ssize_t) total;
+}
+
+static bool copy_loop(int in, int out) {
+    char buffer[65536];
+    ssize_t n;
+
+    while ((n = read_all(in, buffer, sizeof(buffer))) > 0) {
+        if (!write_all(out, buffer, (size_t) n)) return false;
+    }
+
+    return n == 0;
+}
+
+// On btrfs and xfs the copy shares the source's extents and writes no data at all. Elsewhere
+// copy_file_range keeps the bytes in the kernel, and only when that is unsupported (across
+// filesystems on older kernels) they go through a buffer.
+static bool copy_file(const char* source, const char* destination) {
+    int in = open(source, O_RDONLY | O_CLOEXEC);
+    if (in < 0) return false;
+
+    int out = open(destination, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (UNLIKELY(out < 0)) {
+        close(in);
+        return false;
+    }
+
+    bool copied = ioctl(out, FICLONE, in) == 0;
+
+    if (!copied) {
+        bool first = true;
+        ssize_t n;
+
+        copied = true;
+
+        while ((n = copy_file_range(in, NULL, out, NULL, 1 << 30, 0)) != 0) {
+            if (n > 0) {
+                first = false;
+                continue;
+            }
+
+            if (errno == EINTR) continue;
+
+            copied = first && (errno == EXDEV || errno == ENOSYS || errno == EOPNOTSUPP || errno == EINVAL) && copy_loop(in, out);
+            break;
+        }
+    }
+
+    close(in);
+    return close(out) == 0 && copied;
+}
+
+// A hardlink when asked for and possible, a copy otherwise
+static bool place_file(const ObjectCache* cache, const char* source, const char* destination) {
+    if (cache -> link) {
+        unlink(destination);
+        if (link(source, destination) == 0) return true;
+    }
+
+    return copy_file(source, destination);
+}
+
+// CPU time of the calling thread, restores share the CPUs with compiles and may wait for them
+static inline int64_t thread_cpu_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return timespec_ns(&ts);
+}
+
+static bool pack_file(ObjectCache* cache, const char* source, const char* destination) {
+    int in = open(source, O_RDONLY | O_CLOEXEC);
+    if (in < 0) return false;
+
+    struct stat st;
+    int out = fstat(in, &st) == 0 ? open(destination, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644) : -1;
+
+    if (UNLIKELY(out < 0)) {
+        close(in);
+        return false;
+    }
+
+    const PackedHeader header = { CACHE_PACKED_MAGIC, WHISKER_LZ_BLOCK, (uint64_t) st.st_size };
+    uint8_t raw[WHISKER_LZ_BLOCK];
+    uint8_t packed[2 * sizeof(uint32_t) + WHISKER_LZ_BLOCK + WHISKER_LZ_BLOCK / 255 + 16];
+
+    bool written = write_all(out, &header, sizeof(header));
+    uint64_t remaining = header.size;
+    uint64_t packed_size = sizeof(header);
+
+    while (written && remaining > 0) {
+        const size_t size = remaining < WHISKER_LZ_BLOCK ? (size_t) remaining : WHISKER_LZ_BLOCK;
+
+        if (read_all(in, raw, size) != (ssize_t) size) {
+            written = false;
+            break;
+        }
+
+        size_t length = lz_compress(raw, size, packed + 2 * sizeof(uint32_t), size - 1);
+        const uint32_t words[2] = {
+            length != 0 ? (uint32_t) length : (uint32_t) size | CACHE_BLOCK_STORED,
+            (uint32_t) hash64(raw, size, 0)
+        };
+
+        if (length == 0) {
+            memcpy(packed + sizeof(words), raw, size);
+            length = size;
+        }
+
+        memcpy(packed, words, sizeof(words));
+        written = write_all(out, packed, sizeof(words) + length);
+
+        remaining -= size;
+        packed_size += sizeof(words) + length;
+    }
+
+    close(in);
+    written &= close(out) == 0;
+
+    if (written) {
+        __atomic_fetch_add(&cache -> packed_in, header.size, __ATOMIC_RELAXED);
+        __atomic_fetch_add(&cache -> packed_out, packed_size, __ATOMIC_RELAXED);
+    }
+
+    return written;
+}
+
+// Any damage to the entry (a short file, a bad block) fails the restore, which then compiles
+static bool unpack_file(ObjectCache* cache, int in, const PackedHeader* header, const char* destination) {
+    if (header -> block_size != WHISKER_LZ_BLOCK || lseek(in, sizeof(*header), SEEK_SET) < 0) return false;
+
+    int out = open(destination, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (UNLIKELY(out < 0)) return false;
+
+    uint8_t raw[WHISKER_LZ_BLOCK];
+    uint8_t packed[WHISKER_LZ_BLOCK + WHISKER_LZ_BLOCK / 255 + 16];
+
+    uint64_t remaining = header -> size;
+    uint64_t decode_ns = 0;
+    bool unpacked = true;
+
+    while (unpacked && remaining > 0) {
+        const size_t size = remaining < WHISKER_LZ_BLOCK ? (size_t) remaining : WHISKER_LZ_BLOCK;
+        uint32_t words[2];
+
+        if (read_all(in, words, sizeof(words)) != sizeof(words)) {
+            unpacked = false;
+            break;
+        }
+
+        const bool stored = (words[0] & CACHE_BLOCK_STORED) != 0;
+        const size_t length = words[0] & ~CACHE_BLOCK_STORED;
+
+        if ((stored ? length != size : length >= size) || read_all(in, stored ? raw : packed, length) != (ssize_t) length) {
+            unpacked = false;
+            break;
+        }
+
+        // Only decoding and checking is timed, the file system is not the codec's business
+        const int64_t start = thread_cpu_ns();
+        unpacked = (stored || lz_decompress(packed, length, raw, size)) && (uint32_t) hash64(raw, size, 0) == words[1];
+        decode_ns += (uint64_t) (thread_cpu_ns() - start);
+
+        unpacked = unpacked && write_all(out, raw, size);
+
+        remaining -= size;
+    }
+
+    unpacked &= close(out) == 0;
+
+    if (unpacked) {
+        __atomic_fetch_add(&cache -> unpacked_bytes, header -> size, __ATOMIC_RELAXED);
+        __atomic_fetch_add(&cache -> unpack_ns, decode_ns, __ATOMIC_RELAXED);
+    }
+
+    return unpacked;
+}
+
+// Compressed entries start with their header, anything else is a plain object
+static bool restore_entry(ObjectCache* cache, const char* path, const char* destination) {
+    int in = open(path, O_RDONLY | O_CLOEXEC);
+    if (in < 0) return false;
+
+    PackedHeader header;
+
+    if (pread(in, &header, sizeof(header), 0) == sizeof(header) && header.magic == CACHE_PACKED_MAGIC) {
+        const bool unpacked = unpack_file(cache, in, &header, destination);
+        close(in);
+        return unpacked;
+    }
+
+    close(in);
+    return place_file(cache, path, destination);
+}
+
+static void entry_path(const ObjectCache* cache, uint64_t key, char* buffer, size_t size, char kind) {
+    snprintf(buffer, size, "%s/%02x/%014llx.%c", cache -> dir, (unsigned) (key >> 56), (unsigned long long) (key & 0xffffffffffffffull), kind);
+}
+
+// Written under a temporary name and renamed into place, readers never see half an entry
+static bool publish(ObjectCache* cache, uint64_t key, const char* path, const void* data, const char* source) {
+    char temp[PATH_MAX];
+    snprintf(temp, sizeof(temp), "%s/%02x", cache -> dir, (unsigned) (key >> 56));
+
+    if (mkdir(temp, 0755) != 0 && errno != EEXIST) return false;
+
+    // Two threads may store the same key when two targets compile the same source
+    static uint32_t sequence = 0;
+    const uint32_t unique = __atomic_fetch_add(&sequence, 1, __ATOMIC_RELAXED);
+
+    snprintf(temp, sizeof(temp), "%s/%02x/" CACHE_TEMP_PREFIX "%d.%u.%014llx", cache -> dir, (unsigned) (key >> 56), (int) getpid(), unique, (unsigned long long) (key & 0xffffffffffffffull));
+
+    bool written = false;
+
+    if (source != NULL) {
+        written = cache -> compress ? pack_file(cache, source, temp) : place_file(cache, source, temp);
+    } else {
+        int fd = open(temp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+
+        if (fd >= 0) {
+            written = write(fd, data, sizeof(uint64_t)) == sizeof(uint64_t);
+            written &= close(fd) == 0;
+        }
+    }
+
+    struct stat st;
+
+    if (!written || stat(temp, &st) != 0 || rename(temp, path) != 0) {
+        unlink(temp);
+        return false;
+    }
+
+    __atomic_fetch_add(&cache -> stored_bytes, (uint64_t) st.st_size, __ATOMIC_RELAXED);
+    return true;
+}
+
+static uint64_t hash_command(const ObjectCache* cache, const BuildDatabase* db, char* const* argv) {
+    uint64_t hash = hash_bytes(HASH_SEED, &cache -> compiler_hash, sizeof(cache -> compiler_hash));
+
+    for (char* const* arg = argv; *arg != NULL; arg++) {
+        // Where the object and its depfile are written does not change what gets compiled
+        if (strcmp(*arg, "-o") == 0 || strcmp(*arg, "-MF") == 0) {
+            if (arg[1] == NULL) break;
+
+            arg++;
+            continue;
+        }
+
+        hash = hash_string(hash, database_normalize(db, *arg));
+    }
+
+    return hash;
+}
+
+uint64_t cache_key(const ObjectCache* cache, const BuildDatabase* db, char* const* argv, uint64_t source_hash) {
+    uint64_t hash = hash_command(cache, db, argv);
+
+    hash = hash_bytes(hash, &source_hash, sizeof(source_hash));
+    return hash != 0 ? hash : 1;
+}
+
+// 0 when an input is gone, that compile cannot be repeated
+static uint64_t direct_key(const ObjectCache* cache, BuildDatabase* db, char* const* argv, const uint32_t* inputs, uint32_t count) {
+    uint64_t hash = hash_string(hash_command(cache, db, argv), "direct");
+
+    for (uint32_t i = 0; i < count; i++) {
+        const uint64_t content = database_content_hash(db, inputs[i]);
+        if (content == 0) return 0;
+
+        hash = hash_string(hash, database_path(db, inputs[i]));
+        hash = hash_bytes(hash, &content, sizeof(content));
+    }
+
+    return hash != 0 ? hash : 1;
+}
+
+bool cache_lookup_direct(ObjectCache* cache, BuildDatabase* db, char* const* argv, const uint32_t* inputs, uint32_t count, uint64_t* key) {
+    const uint64_t direct = direct_key(cache, db, argv, inputs, count);
+    if (direct == 0) return false;
+
+    char path[PATH_MAX];
+    entry_path(cache, direct, path, sizeof(path), 'm');
+
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return false;
+
+    const bool found = read(fd, key, sizeof(*key)) == sizeof(*key) && *key != 0;
+    close(fd);
+
+    if (found) {
+        utimensat(AT_FDCWD, path, NULL, 0);
+    }
+
+    return found;
+}
+
+void cache_store_direct(ObjectCache* cache, BuildDatabase* db, char* const* argv, const uint32_t* inputs, uint32_t count, uint64_t key, int64_t since_ns) {
+    const uint64_t direct = direct_key(cache, db, argv, inputs, count);
+    if (direct == 0) return;
+
+    // A file edited while the compile ran may not be what the hash above describes
+    for (uint32_t i = 0; i < count; i++) {
+        if (!database_settled(db, inputs[i], since_ns)) return;
+    }
+
+    char path[PATH_MAX];
+    entry_path(cache, direct, path, sizeof(path), 'm');
+    publish(cache, direct, path, &key, NULL);
+}
+
+bool cache_restore(ObjectCache* cache, uint64_t key, const char* object, bool direct) {
+    char path[PATH_MAX];
+    char temp[PATH_MAX];
+
+    entry_path(cache, key, path, sizeof(path), 'o');
+    snprintf(temp, sizeof(temp), "%s.tmp", object);
+
+    // Copied next to the object and renamed over it, so a failed restore never leaves half an object
+    if (!restore_entry(cache, path, temp) || rename(temp, object) != 0) {
+        unlink(temp);
+
+        if (!direct) {
+            __atomic_fetch_add(&cache -> misses, 1, __ATOMIC_RELAXED);
+        }
+
+        return false;
+    }
+
+    // Eviction goes by the later of mtime and ctime. A hardlinked entry is the same inode as
+    // objects in other projects, touching it would make all of them look newer than their links,
+    // but the link() just made already moved its ctime.
+    struct stat st;
+    if (stat(path, &st) == 0 && st.st_nlink == 1) {
+        utimensat(AT_FDCWD, path, NULL, 0);
+    }
+
+    __atomic_fetch_add(&cache -> hits, 1, __ATOMIC_RELAXED);
+
+    if (direct) {
+        __atomic_fetch_add(&cache -> direct_hits, 1, __ATOMIC_RELAXED);
+    }
+
+    return true;
+}
+
+void cache_store(ObjectCache* cache, uint64_t key, const char* object) {
+    char path[PATH_MAX];
+    entry_path(cache, key, path, sizeof(path), 'o');
+
+    if (publish(cache, key, path, NULL, object)) {
+        __atomic_fetch_add(&cache -> stores, 1, __ATOMIC_RELAXED);
+    }
+}
+
+static int compare_age(const void* a, const void* b) {
+    const int64_t x = ((const CacheFile*) a) -> used_ns;
+    const int64_t y = ((const CacheFile*) b) -> used_ns;
+
+    return (x > y) - (x < y);
+}
+
+// Removes the least recently used entries until at most 'target' bytes are left, along with
+// temporaries a crashed build left behind. Returns the size that is left.
+static uint64_t evict(ArenaAllocator* arena, const char* dir, uint64_t target) {
+    uint32_t capacity = 1024;
+    uint32_t count = 0;
+    CacheFile* files = arena_array(arena, CacheFile, capacity);
+    uint64_t total = 0;
+
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+
+    for (uint32_t bucket = 0; bucket < 256; bucket++) {
+        char path[PATH_MAX];
+        snprintf(path, sizeof(path), "%s/%02x", dir, bucket);
+
+        DIR* handle = opendir(path);
+        if (handle == NULL) continue;
+
+        struct dirent* entry;
+
+        while ((entry = readdir(handle)) != NULL) {
+            if (entry -> d_name[0] == '.') continue;
+
+            struct stat st;
+            if (fstatat(dirfd(handle), entry -> d_name, &st, 0) != 0 || !S_ISREG(st.st_mode)) continue;
+
+            const size_t len = strlen(path) + strlen(entry -> d_name) + 2;
+            char* file = arena_alloc(arena, len);
+            snprintf(file, len, "%s/%s", path, entry -> d_name);
+
+            if (strncmp(entry -> d_name, CACHE_TEMP_PREFIX, strlen(CACHE_TEMP_PREFIX)) == 0) {
+                if (timespec_ns(&now) - timespec_ns(&st.st_mtim) > CACHE_TEMP_MAX_AGE_NS) {
+                    unlink(file);
+                }
+
+                continue;
+            }
+
+            if (UNLIKELY(count == capacity)) {
+                files = grow(arena, files, sizeof(CacheFile) * capacity, sizeof(CacheFile) * capacity * 2);
+                capacity *= 2;
+            }
+
+            const int64_t mtime_ns = timespec_ns(&st.st_mtim);
+            const int64_t ctime_ns = timespec_ns(&st.st_ctim);
+
+            files[count++] = (CacheFile) { file, mtime_ns > ctime_ns ? mtime_ns : ctime_ns, (uint64_t) st.st_size };
+            total += (uint64_t) st.st_size;
+        }
+
+        closedir(handle);
+    }
+
+    qsort(files, count, sizeof(CacheFile), compare_age);
+
+    for (uint32_t i = 0; i < count && total > target; i++) {
+        if (unlink(files[i].path) == 0) {
+            total -= files[i].size;
+        }
+    }
+
+    return total;
+}
+
+static int lock_stats(const char* dir, int operation) {
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), "%s/" CACHE_STATS_FILE, dir);
+
+    int fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (UNLIKELY(fd < 0)) return -1;
+
+    flock(fd, operation);
+    return fd;
+}
+
+static void read_stats(int fd, CacheStats* stats) {
+    if (pread(fd, stats, sizeof(*stats), 0) != sizeof(*stats)) {
+        memset(stats, 0, sizeof(*stats));
+    }
+}
+
+// Adds this build's numbers to the totals, evicting down to 90% of the limit once it is exceeded
+void cache_close(ObjectCache* cache) {
+    if (!cache -> enabled || cache -> hits + cache -> misses + cache -> stores == 0) return;
+
+    int fd = lock_stats(cache -> dir, LOCK_EX);
+    if (UNLIKELY(fd < 0)) return;
+
+    CacheStats stats;
+    read_stats(fd, &stats);
+
+    stats.hits += cache -> hits;
+    stats.misses += cache -> misses;
+    stats.size += cache -> stored_bytes;
+
+    if (stats.size > cache -> limit) {
+        stats.size = evict(cache -> arena, cache -> dir, cache -> limit / 100 * CACHE_EVICT_PERCENT);
+    }
+
+    pwrite(fd, &stats, sizeof(stats), 0);
+    close(fd);
+}
+
+void cache_print_stats(ArenaAllocator* arena) {
+    const char* dir = cache_root(arena);
+    if (dir == NULL) return;
+
+    CacheStats stats = {0};
+    int fd = -1;
+
+    if (access(dir, F_OK) == 0 && (fd = lock_stats(dir, LOCK_SH)) >= 0) {
+        read_stats(fd, &stats);
+        close(fd);
+    }
+
+    const uint64_t lookups = stats.hits + stats.misses;
+
+    printf("\033[1mCache:\033[0m %s\n", dir);
+    printf("  hits: %lu\n", (unsigned long) stats.hits);
+    printf("  misses: %lu\n", (unsigned long) stats.misses);
+    printf("  hit rate: %.1f%%\n", lookups != 0 ? 100.0 * (double) stats.hits / (double) lookups : 0.0);
+    printf("  size: %.1fM\n", (double) stats.size / (1024.0 * 1024.0));
+}
+
+void cache_clear(ArenaAllocator* arena) {
+    const char* dir = cache_root(arena);
+    if (dir == NULL || access(dir, F_OK) != 0) return;
+
+    int fd = lock_stats(dir, LOCK_EX);
+    if (UNLIKELY(fd < 0)) return;
+
+    const CacheStats stats = { 0, 0, evict(arena, dir, 0), 0 };
+
+    pwrite(fd, &stats, sizeof(stats), 0);
+    close(fd);
+}
@@ -0,0 +1,76 @@
+#ifndef CACHE_H
+#define CACHE_H
+
+#include "database.h"
+
+#include "../config/config.h"
+#include "../utils/arena.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ *  Local object cache, $XDG_CACHE_HOME/catalyze or ~/.cache/catalyze
+ *
+ *  Objects are stored by a key over the compiler's identity (path, size and mtime), the
+ *  compile command without its output paths and the hash of the preprocessed source, as
+ *  <dir>/<first byte of the key>/<rest of the key>.o. Every project on the machine shares it.
+ *
+ *  Direct mode skips the preprocessor: a manifest <dir>/<..>/<..>.m, keyed on the command and
+ *  the content of every file the last compile of the object read (the source and the headers
+ *  from its depfile), holds the key of the object that compile produced. It is only written
+ *  when none of those files changed while the compile ran.
+ *
+ *  Entries are cloned into place where the filesystem shares extents (btrfs, xfs), copied
+ *  inside the kernel elsewhere, or hardlinked with 'cache_restore: link'. Restores are safe to
+ *  run from worker threads.
+ *
+ *  With 'cache_compress: true' objects are stored compressed by whisker_lz in independent 64K
+ *  blocks. Plain and compressed entries can share a cache, a restore tells them apart by the
+ *  header.
+ *
+ *  A hit refreshes the entry's mtime. Once the cache grows past its limit the entries that
+ *  were used longest ago are removed. The totals live in <dir>/stats, which also serializes
+ *  concurrent builds while they update it.
+ */
+
+typedef struct {
+    ArenaAllocator* arena;
+    const char* dir;
+    uint64_t limit;
+    uint64_t compiler_hash;
+    uint64_t stored_bytes;
+    uint32_t hits;
+    uint32_t direct_hits;
+    uint32_t misses;
+    uint32_t stores;
+    uint64_t packed_in;
+    uint64_t packed_out;
+    uint64_t unpacked_bytes;
+    uint64_t unpack_ns;
+    bool link;
+    bool compress;
+    bool enabled;
+} ObjectCache;
+
+// Enabled by the 'cache' config key, which sets the size limit
+void cache_open(ArenaAllocator* arena, ObjectCache* cache, const CatalyzeConfig* config);
+void cache_close(ObjectCache* cache);
+
+// Never 0, so 0 can stand for "no key"
+uint64_t cache_key(const ObjectCache* cache, const BuildDatabase* db, char* const* argv, uint64_t source_hash);
+
+// Copies the cached object to 'object', false on a miss. A failed direct restore is not counted
+// as a miss, the preprocessed lookup that follows it decides.
+bool cache_restore(ObjectCache* cache, uint64_t key, const char* object, bool direct);
+void cache_store(ObjectCache* cache, uint64_t key, const char* object);
+
+// Direct mode, 'inputs' are the path ids the object was last built from
+bool cache_lookup_direct(ObjectCache* cache, BuildDatabase* db, char* const* argv, const uint32_t* inputs, uint32_t count, uint64_t* key);
+void cache_store_direct(ObjectCache* cache, BuildDatabase* db, char* const* argv, const uint32_t* inputs, uint32_t count, uint64_t key, int64_t since_ns);
+
+// For 'catalyze cache' and 'catalyze cache clear'
+void cache_print_stats(ArenaAllocator* arena);
+void cache_clear(ArenaAllocator* arena);
+
+#endif // !CACHE_H
@@ -0,0 +1,977 @@
+#include "database.h"
+
+#include "../utils/hash.h"
+#include "../utils/macros.h"
+
+#define WHISKER_NOPREFIX
+#include "../../whisker/hash/whisker_hash.h"
+#include "../../whisker/pool/whisker_pool.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define DATABASE_MAGIC "CATDB\0\0\0"
+#define DATABASE_VERSION 2
+#define COMPACT_MIN_DEAD 64
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t reserved;
+} DatabaseHeader;
+
+typedef enum {
+    RecordPath = 1,
+    RecordOutput = 2,
+    RecordFile = 3
+} RecordKind;
+
+typedef struct {
+    uint32_t kind;
+    uint32_t size;
+} RecordHeader;
+
+typedef struct {
+    uint32_t len;
+    char path[];
+} PathRecord;
+
+enum {
+    StatUnknown,
+    StatPresent,
+    StatMissing
+};
+
+enum {
+    HashUnknown,
+    HashQueued,
+    HashKnown
+};
+
+static inline size_t padded(size_t size) {
+    return (size + 7) & ~(size_t) 7;
+}
+
+static inline uint32_t hash_key(const char* s) {
+    uint32_t hash = 5381;
+    while (*s) {
+        hash = ((hash << 5) + hash) + *s++;
+    }
+    return hash;
+}
+
+static void* grow(ArenaAllocator* arena, void* ptr, const size_t old_size, const size_t new_size) {
+    void* result = arena_alloc(arena, new_size);
+
+    if (old_size != 0) {
+        arena_memcpy(result, ptr, old_size);
+    }
+
+    return result;
+}
+
+// "./src/a.c" and "src/a.c" are the same file, and paths reached through the prefix are
+// stored relative to the project root, so runs from subdirectories share the database
+static inline const char* skip_current_dir(const char* path) {
+    while (path[0] == '.' && path[1] == '/') {
+        path += 2;
+    }
+
+    return path;
+}
+
+static const char* normalize(const BuildDatabase* db, const char* path) {
+    path = skip_current_dir(path);
+
+    if (db -> prefix_len != 0 && strncmp(path, db -> prefix, db -> prefix_len) == 0) {
+        path += db -> prefix_len;
+    }
+
+    return path;
+}
+
+static const char* resolve(const BuildDatabase* db, const char* key, char* buffer, size_t size) {
+    if (key[0] == '/' || db -> prefix_len == 0) return key;
+
+    snprintf(buffer, size, "%s%s", db -> prefix, key);
+    return buffer;
+}
+
+static uint32_t find_slot(const BuildDatabase* db, const char* key) {
+    uint32_t slot = hash_key(key) & db -> index_mask;
+
+    while (db -> index[slot] != 0 && strcmp(db -> entries[db -> index[slot] - 1].key, key) != 0) {
+        slot = (slot + 1) & db -> index_mask;
+    }
+
+    return slot;
+}
+
+static void grow_index(BuildDatabase* db) {
+    const uint32_t capacity = (db -> index_mask + 1) * 2;
+
+    db -> index = arena_array_zero(db -> arena, uint32_t, capacity);
+    db -> index_mask = capacity - 1;
+
+    for (uint32_t id = 0; id < db -> entry_count; id++) {
+        const uint32_t slot = find_slot(db, db -> entries[id].key);
+
+        if (db -> index[slot] == 0) {
+            db -> index[slot] = id + 1;
+        }
+    }
+}
+
+// Ids are positions in the log, so an entry is always appended, even for a key seen before
+static uint32_t add_entry(BuildDatabase* db, const char* key) {
+    if (UNLIKELY(db -> entry_count == db -> entry_capacity)) {
+        const uint32_t capacity = db -> entry_capacity * 2;
+        db -> entries = grow(db -> arena, db -> entries, sizeof(DatabaseEntry) * db -> entry_capacity, sizeof(DatabaseEntry) * capacity);
+        db -> entry_capacity = capacity;
+    }
+
+    if (UNLIKELY((db -> entry_count + 1) * 2 > db -> index_mask + 1)) {
+        grow_index(db);
+    }
+
+    const uint32_t id = db -> entry_count++;
+    DatabaseEntry* entry = &db -> entries[id];
+
+    entry -> key = key;
+    entry -> record = NULL;
+    entry -> file = NULL;
+    entry -> stat_state = StatUnknown;
+    entry -> hash_state = HashUnknown;
+
+    const uint32_t slot = find_slot(db, key);
+    if (db -> index[slot] == 0) {
+        db -> index[slot] = id + 1;
+    }
+
+    return id;
+}
+
+static uint32_t lookup(const BuildDatabase* db, const char* key) {
+    const uint32_t slot = find_slot(db, key);
+    return db -> index[slot] != 0 ? db -> index[slot] - 1 : UINT32_MAX;
+}
+
+static bool write_all(int fd, const void* data, size_t len) {
+    const char* bytes = data;
+
+    while (len > 0) {
+        ssize_t n = write(fd, bytes, len);
+
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+
+        bytes += n;
+        len -= (size_t) n;
+    }
+
+    return true;
+}
+
+// Holds the database exclusively for the whole build, a second build in the same tree waits.
+// A compaction replaces the file, so a lock taken on the old inode is retried on the new one.
+static int open_locked(const char* path) {
+    bool announced = false;
+
+    while (true) {
+        int fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+        if (UNLIKELY(fd < 0)) return -1;
+
+        if (flock(fd, LOCK_EX | LOCK_NB) != 0) {
+            if (!announced) {
+                printf("Waiting for another catalyze build in this directory...\n");
+                fflush(stdout);
+                announced = true;
+            }
+
+            flock(fd, LOCK_EX);
+        }
+
+        struct stat locked;
+        struct stat current;
+
+        if (fstat(fd, &locked) == 0 && stat(path, &current) == 0 && locked.st_ino == current.st_ino && locked.st_dev == current.st_dev) {
+            return fd;
+        }
+
+        close(fd);
+    }
+}
+
+// Walks the log, stopping at the first record that is torn or does not make sense. Paths already
+// loaded are only pointed at their record again.
+static void load_records(BuildDatabase* db) {
+    const uint8_t* map = db -> map;
+    const size_t size = db -> map_size;
+    size_t offset = sizeof(DatabaseHeader);
+    uint32_t paths = 0;
+
+    while (size - offset >= sizeof(RecordHeader)) {
+        const RecordHeader* header = (const RecordHeader*) (map + offset);
+        const size_t payload_size = header -> size;
+
+        if (padded(payload_size) > size - offset - sizeof(RecordHeader)) break;
+
+        const void* payload = map + offset + sizeof(RecordHeader);
+
+        if (header -> kind == RecordPath) {
+            const PathRecord* path = payload;
+
+            if (payload_size < sizeof(PathRecord) + 1 || path -> len != payload_size - sizeof(PathRecord) - 1 || path -> path[path -> len] != 0) break;
+
+            if (paths < db -> entry_count) {
+                db -> entries[paths].key = path -> path;
+            } else {
+                add_entry(db, path -> path);
+            }
+
+            paths++;
+        } else if (header -> kind == RecordOutput) {
+            const DatabaseRecord* record = payload;
+
+            if (payload_size < sizeof(DatabaseRecord) || payload_size != sizeof(DatabaseRecord) + (size_t) record -> input_count * sizeof(uint32_t)) break;
+            if (record -> output >= paths) break;
+
+            bool valid = true;
+            for (uint32_t i = 0; i < record -> input_count && valid; i++) {
+                valid = record -> inputs[i] < paths;
+            }
+
+            if (!valid) break;
+
+            if (db -> entries[record -> output].record != NULL) {
+                db -> dead++;
+            } else {
+                db -> live++;
+            }
+
+            db -> entries[record -> output].record = record;
+        } else if (header -> kind == RecordFile) {
+            const DatabaseFile* file = payload;
+
+            if (payload_size != sizeof(DatabaseFile) || file -> path >= paths) break;
+
+            if (db -> entries[file -> path].file != NULL) {
+                db -> dead++;
+            } else {
+                db -> live++;
+            }
+
+            db -> entries[file -> path].file = file;
+        } else {
+            break;
+        }
+
+        offset += sizeof(RecordHeader) + padded(payload_size);
+    }
+
+    db -> valid_size = offset;
+}
+
+void database_open(ArenaAllocator* arena, BuildDatabase* db, const CatalyzeConfig* config) {
+    const size_t prefix_len = config -> prefix_len;
+    const size_t build_dir_len = strlen(config -> build_dir);
+    const size_t name_len = strlen(DATABASE_FILE);
+
+    char* path = arena_alloc(arena, prefix_len + build_dir_len + name_len + 2);
+    snprintf(path, prefix_len + build_dir_len + name_len + 2, "%s%s%s%s", config -> prefix, config -> build_dir, build_dir_len && config -> build_dir[build_dir_len - 1] != '/' ? "/" : "", DATABASE_FILE);
+
+    db -> arena = arena;
+    db -> scratch = arena;
+    db -> path = path;
+    db -> prefix = skip_current_dir(config -> prefix);
+    db -> prefix_len = strlen(db -> prefix);
+    db -> map = NULL;
+    db -> map_size = 0;
+    db -> valid_size = 0;
+    db -> entry_capacity = 256;
+    db -> entries = arena_array(arena, DatabaseEntry, db -> entry_capacity);
+    db -> entry_count = 0;
+    db -> persisted = 0;
+    db -> index_mask = 511;
+    db -> index = arena_array_zero(arena, uint32_t, db -> index_mask + 1);
+    db -> dirty_capacity = 64;
+    db -> dirty = arena_array(arena, uint32_t, db -> dirty_capacity);
+    db -> dirty_count = 0;
+    db -> live = 0;
+    db -> dead = 0;
+    db -> content = config -> check == CheckContent;
+    db -> locked = true;
+    db -> fd = open_locked(path);
+
+    // Without a database every job simply looks new
+    if (UNLIKELY(db -> fd < 0)) return;
+
+    struct stat st;
+    if (fstat(db -> fd, &st) == 0 && (size_t) st.st_size >= sizeof(DatabaseHeader)) {
+        void* map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, db -> fd, 0);
+
+        if (map != MAP_FAILED) {
+            const DatabaseHeader* header = map;
+
+            db -> map = map;
+            db -> map_size = st.st_size;
+
+            if (memcmp(header -> magic, DATABASE_MAGIC, sizeof(header -> magic)) == 0 && header -> version == DATABASE_VERSION) {
+                load_records(db);
+            }
+        }
+    }
+
+    // A torn tail is cut off, an unknown or empty file starts over
+    if (db -> valid_size == 0) {
+        const DatabaseHeader header = { DATABASE_MAGIC, DATABASE_VERSION, 0 };
+
+        if (ftruncate(db -> fd, 0) != 0 || !write_all(db -> fd, &header, sizeof(header))) {
+            close(db -> fd);
+            db -> fd = -1;
+            return;
+        }
+
+        db -> valid_size = sizeof(header);
+    } else if (db -> valid_size < db -> map_size) {
+        if (ftruncate(db -> fd, db -> valid_size) != 0) {
+            close(db -> fd);
+            db -> fd = -1;
+            return;
+        }
+    }
+
+    lseek(db -> fd, db -> valid_size, SEEK_SET);
+    db -> persisted = db -> entry_count;
+}
+
+static void append_path(FILE* fptr, const char* key) {
+    const uint32_t len = (uint32_t) strlen(key);
+    const RecordHeader header = { RecordPath, (uint32_t) (sizeof(PathRecord) + len + 1) };
+    static const char padding[8] = {0};
+
+    fwrite(&header, sizeof(header), 1, fptr);
+    fwrite(&len, sizeof(len), 1, fptr);
+    fwrite(key, 1, len + 1, fptr);
+    fwrite(padding, 1, padded(header.size) - header.size, fptr);
+}
+
+// Rewrites the log with only the latest record per output and the paths those still use. Gives
+// each old id's new one, UINT32_MAX for dropped paths, or NULL when the log was left as it was.
+static uint32_t* compact(BuildDatabase* db) {
+    const size_t path_len = strlen(db -> path);
+    char temp[path_len + 5];
+    snprintf(temp, sizeof(temp), "%s.tmp", db -> path);
+
+    FILE* fptr = fopen(temp, "w");
+    if (UNLIKELY(fptr == NULL)) return NULL;
+
+    uint32_t* remap = arena_array(db -> scratch, uint32_t, db -> entry_count);
+    memset(remap, 0xff, sizeof(uint32_t) * db -> entry_count);
+    uint32_t next = 0;
+
+    const DatabaseHeader header = { DATABASE_MAGIC, DATABASE_VERSION, 0 };
+    fwrite(&header, sizeof(header), 1, fptr);
+
+    for (uint32_t id = 0; id < db -> entry_count; id++) {
+        const DatabaseRecord* record = db -> entries[id].record;
+        if (record == NULL) continue;
+
+        if (remap[record -> output] == UINT32_MAX) {
+            remap[record -> output] = next++;
+            append_path(fptr, db -> entries[record -> output].key);
+        }
+
+        for (uint32_t i = 0; i < record -> input_count; i++) {
+            if (remap[record -> inputs[i]] != UINT32_MAX) continue;
+
+            remap[record -> inputs[i]] = next++;
+            append_path(fptr, db -> entries[record -> inputs[i]].key);
+        }
+
+        const size_t size = sizeof(DatabaseRecord) + record -> input_count * sizeof(uint32_t);
+        const RecordHeader record_header = { RecordOutput, (uint32_t) size };
+
+        DatabaseRecord fixed = *record;
+        fixed.output = remap[record -> output];
+
+        fwrite(&record_header, sizeof(record_header), 1, fptr);
+        fwrite(&fixed, sizeof(fixed), 1, fptr);
+
+        for (uint32_t i = 0; i < record -> input_count; i++) {
+            fwrite(&remap[record -> inputs[i]], sizeof(uint32_t), 1, fptr);
+        }
+
+        static const char padding[8] = {0};
+        fwrite(padding, 1, padded(size) - size, fptr);
+    }
+
+    // Stat data and hashes are only worth keeping for paths that are still referenced
+    for (uint32_t id = 0; id < db -> entry_count; id++) {
+        const DatabaseFile* file = db -> entries[id].file;
+        if (file == NULL || remap[id] == UINT32_MAX) continue;
+
+        const RecordHeader file_header = { RecordFile, (uint32_t) sizeof(DatabaseFile) };
+
+        DatabaseFile fixed = *file;
+        fixed.path = remap[id];
+
+        fwrite(&file_header, sizeof(file_header), 1, fptr);
+        fwrite(&fixed, sizeof(fixed), 1, fptr);
+    }
+
+    if (fclose(fptr) == 0 && rename(temp, db -> path) == 0) return remap;
+
+    unlink(temp);
+    return NULL;
+}
+
+static inline int64_t timespec_ns(const struct timespec* ts) {
+    return (int64_t) ts -> tv_sec * 1000000000ll + ts -> tv_nsec;
+}
+
+// New paths first, then the file records and the output record using them, all in one write
+static void flush(BuildDatabase* db, const DatabaseRecord* record, size_t record_size) {
+    size_t size = record != NULL ? sizeof(RecordHeader) + padded(record_size) : 0;
+    size += db -> dirty_count * (sizeof(RecordHeader) + sizeof(DatabaseFile));
+
+    for (uint32_t id = db -> persisted; id < db -> entry_count; id++) {
+        size += sizeof(RecordHeader) + padded(sizeof(PathRecord) + strlen(db -> entries[id].key) + 1);
+    }
+
+    char* buffer = arena_alloc(db -> scratch, size);
+    char* cursor = buffer;
+    memset(buffer, 0, size);
+
+    for (uint32_t id = db -> persisted; id < db -> entry_count; id++) {
+        const char* key = db -> entries[id].key;
+        const uint32_t len = (uint32_t) strlen(key);
+        const RecordHeader header = { RecordPath, (uint32_t) (sizeof(PathRecord) + len + 1) };
+
+        memcpy(cursor, &header, sizeof(header));
+        memcpy(cursor + sizeof(header), &len, sizeof(len));
+        memcpy(cursor + sizeof(header) + sizeof(len), key, len + 1);
+        cursor += sizeof(header) + padded(header.size);
+    }
+
+    DatabaseFile* files = arena_array(db -> scratch, DatabaseFile, db -> dirty_count);
+
+    for (uint32_t i = 0; i < db -> dirty_count; i++) {
+        const RecordHeader header = { RecordFile, (uint32_t) sizeof(DatabaseFile) };
+
+        files[i] = db -> entries[db -> dirty[i]].current;
+        files[i].path = db -> dirty[i];
+        files[i].reserved = 0;
+
+        memcpy(cursor, &header, sizeof(header));
+        memcpy(cursor + sizeof(header), &files[i], sizeof(DatabaseFile));
+        cursor += sizeof(header) + sizeof(DatabaseFile);
+    }
+
+    if (record != NULL) {
+        const RecordHeader header = { RecordOutput, (uint32_t) record_size };
+        memcpy(cursor, &header, sizeof(header));
+        memcpy(cursor + sizeof(header), record, record_size);
+    }
+
+    if (UNLIKELY(!write_all(db -> fd, buffer, size))) {
+        // A partial write leaves a torn record that the next load cuts off, stop appending
+        close(db -> fd);
+        db -> fd = -1;
+        return;
+    }
+
+    for (uint32_t i = 0; i < db -> dirty_count; i++) {
+        DatabaseEntry* entry = &db -> entries[db -> dirty[i]];
+
+        if (entry -> file != NULL) {
+            db -> dead++;
+        } else {
+            db -> live++;
+        }
+
+        entry -> file = &files[i];
+    }
+
+    db -> persisted = db -> entry_count;
+    db -> dirty_count = 0;
+}
+
+void database_close(BuildDatabase* db) {
+    if (db -> locked && db -> fd >= 0 && db -> dirty_count != 0) {
+        flush(db, NULL, 0);
+    }
+
+    if (db -> locked && db -> fd >= 0 && db -> dead > db -> live && db -> dead >= COMPACT_MIN_DEAD) {
+        compact(db);
+    }
+
+    if (db -> map != NULL) {
+        munmap(db -> map, db -> map_size);
+        db -> map = NULL;
+    }
+
+    if (db -> fd >= 0) {
+        close(db -> fd);
+        db -> fd = -1;
+    }
+}
+
+// Records and file records written during a build were copied into the scratch arena, the log
+// now holds them all, so every entry is pointed into a fresh map of it
+static void remap(BuildDatabase* db) {
+    struct stat st;
+
+    if (db -> fd >= 0 && fstat(db -> fd, &st) == 0 && (size_t) st.st_size != db -> map_size) {
+        void* map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, db -> fd, 0);
+
+        if (map != MAP_FAILED) {
+            if (db -> map != NULL) {
+                munmap(db -> map, db -> map_size);
+            }
+
+            db -> map = map;
+            db -> map_size = st.st_size;
+        }
+    }
+
+    // Whatever failed to reach the log is dropped, its jobs simply run again
+    for (uint32_t id = 0; id < db -> entry_count; id++) {
+        db -> entries[id].record = NULL;
+        db -> entries[id].file = NULL;
+    }
+
+    db -> live = 0;
+    db -> dead = 0;
+
+    if (db -> map != NULL) {
+        load_records(db);
+    }
+}
+
+// Loads the log a compaction just wrote in place of the old one. Paths it kept keep their
+// cached stat and hash under their new id, everything else is forgotten.
+static void reload(BuildDatabase* db, const uint32_t* ids) {
+    const int fd = open_locked(db -> path);
+    struct stat st;
+    void* map = MAP_FAILED;
+
+    if (fd >= 0 && fstat(fd, &st) == 0) {
+        map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+
+    close(db -> fd);
+    db -> fd = -1;
+
+    if (UNLIKELY(map == MAP_FAILED)) {
+        if (fd >= 0) close(fd);
+        return;
+    }
+
+    const uint32_t count = db -> entry_count;
+    DatabaseEntry* old = arena_array(db -> scratch, DatabaseEntry, count);
+    memcpy(old, db -> entries, sizeof(DatabaseEntry) * count);
+
+    // The compacted log holds fewer paths than were loaded, so the arrays are reused
+    memset(db -> index, 0, sizeof(uint32_t) * (db -> index_mask + 1));
+    db -> entry_count = 0;
+    db -> live = 0;
+    db -> dead = 0;
+
+    if (db -> map != NULL) {
+        munmap(db -> map, db -> map_size);
+    }
+
+    db -> map = map;
+    db -> map_size = st.st_size;
+    load_records(db);
+
+    for (uint32_t id = 0; id < count; id++) {
+        if (ids[id] >= db -> entry_count) continue;
+
+        DatabaseEntry* entry = &db -> entries[ids[id]];
+        entry -> current = old[id].current;
+        entry -> current.path = ids[id];
+        entry -> mtime = old[id].mtime;
+        entry -> stat_state = old[id].stat_state;
+        entry -> hash_state = old[id].hash_state;
+    }
+
+    db -> fd = fd;
+    db -> persisted = db -> entry_count;
+    lseek(fd, db -> valid_size, SEEK_SET);
+}
+
+bool database_unlock(BuildDatabase* db) {
+    if (!db -> locked) return false;
+    db -> locked = false;
+
+    if (db -> fd >= 0 && db -> dirty_count != 0) {
+        flush(db, NULL, 0);
+    }
+
+    remap(db);
+
+    bool renumbered = false;
+
+    if (db -> fd >= 0 && db -> dead > db -> live && db -> dead >= COMPACT_MIN_DEAD) {
+        const uint32_t* ids = compact(db);
+
+        if (ids != NULL) {
+            reload(db, ids);
+            renumbered = true;
+        }
+    }
+
+    db -> scratch = db -> arena;
+
+    if (db -> fd < 0) return renumbered;
+
+    // What the file looked like when it was let go, anything else means another build wrote to it
+    if (UNLIKELY(fstat(db -> fd, &db -> released) != 0)) {
+        close(db -> fd);
+        db -> fd = -1;
+        return renumbered;
+    }
+
+    flock(db -> fd, LOCK_UN);
+    return renumbered;
+}
+
+bool database_lock(BuildDatabase* db, ArenaAllocator* scratch) {
+    if (db -> locked) {
+        db -> scratch = scratch;
+        return true;
+    }
+
+    if (db -> fd < 0) return false;
+
+    // A compaction in between replaced the file, open_locked follows the path to the new one
+    const int fd = open_locked(db -> path);
+    struct stat st;
+
+    const bool unchanged = fd >= 0 && fstat(fd, &st) == 0
+        && st.st_dev == db -> released.st_dev
+        && st.st_ino == db -> released.st_ino
+        && st.st_size == db -> released.st_size
+        && timespec_ns(&st.st_mtim) == timespec_ns(&db -> released.st_mtim);
+
+    if (!unchanged) {
+        if (fd >= 0) close(fd);
+        return false;
+    }
+
+    close(db -> fd);
+    db -> fd = fd;
+    db -> scratch = scratch;
+    db -> locked = true;
+    lseek(fd, 0, SEEK_END);
+
+    return true;
+}
+
+uint32_t database_intern(BuildDatabase* db, const char* path) {
+    const char* key = normalize(db, path);
+    const uint32_t id = lookup(db, key);
+
+    if (id != UINT32_MAX) return id;
+
+    const size_t len = strlen(key);
+    char* copy = arena_alloc(db -> arena, len + 1);
+    memcpy(copy, key, len + 1);
+
+    return add_entry(db, copy);
+}
+
+uint32_t database_lookup(const BuildDatabase* db, const char* path) {
+    return lookup(db, normalize(db, path));
+}
+
+const char* database_normalize(const BuildDatabase* db, const char* path) {
+    return normalize(db, path);
+}
+
+const char* database_path(const BuildDatabase* db, uint32_t id) {
+    return db -> entries[id].key;
+}
+
+const DatabaseRecord* database_find(const BuildDatabase* db, const char* path) {
+    const uint32_t id = lookup(db, normalize(db, path));
+    return id != UINT32_MAX ? db -> entries[id].record : NULL;
+}
+
+static void fill_stat(DatabaseEntry* entry, const struct stat* st) {
+    entry -> mtime = st -> st_mtim;
+    entry -> current.size = (uint64_t) st -> st_size;
+    entry -> current.mtime_ns = timespec_ns(&st -> st_mtim);
+    entry -> current.ctime_ns = timespec_ns(&st -> st_ctim);
+    entry -> current.inode = (uint64_t) st -> st_ino;
+    entry -> stat_state = StatPresent;
+}
+
+static bool stat_entry(const BuildDatabase* db, DatabaseEntry* entry) {
+    if (entry -> stat_state == StatUnknown) {
+        char buffer[PATH_MAX];
+        struct stat st;
+
+        if (stat(resolve(db, entry -> key, buffer, sizeof(buffer)), &st) == 0) {
+            fill_stat(entry, &st);
+        } else {
+            entry -> stat_state = StatMissing;
+        }
+    }
+
+    return entry -> stat_state == StatPresent;
+}
+
+bool database_mtime(BuildDatabase* db, uint32_t id, struct timespec* mtime) {
+    DatabaseEntry* entry = &db -> entries[id];
+    const bool present = stat_entry(db, entry);
+
+    *mtime = entry -> mtime;
+    return present;
+}
+
+void database_forget(BuildDatabase* db, uint32_t id) {
+    db -> entries[id].stat_state = StatUnknown;
+    db -> entries[id].hash_state = HashUnknown;
+}
+
+// A checkout, touch or cache restore always changes the ctime, so matching stat data
+// means the recorded hash still describes the file
+static inline bool file_unchanged(const DatabaseEntry* entry) {
+    const DatabaseFile* file = entry -> file;
+
+    return file != NULL
+        && file -> size == entry -> current.size
+        && file -> mtime_ns == entry -> current.mtime_ns
+        && file -> ctime_ns == entry -> current.ctime_ns
+        && file -> inode == entry -> current.inode;
+}
+
+static void remember_hash(BuildDatabase* db, uint32_t id, uint64_t hash) {
+    DatabaseEntry* entry = &db -> entries[id];
+
+    entry -> current.hash = hash;
+    entry -> hash_state = HashKnown;
+
+    if (UNLIKELY(db -> dirty_count == db -> dirty_capacity)) {
+        const uint32_t capacity = db -> dirty_capacity * 2;
+        db -> dirty = grow(db -> arena, db -> dirty, sizeof(uint32_t) * db -> dirty_capacity, sizeof(uint32_t) * capacity);
+        db -> dirty_capacity = capacity;
+    }
+
+    db -> dirty[db -> dirty_count++] = id;
+}
+
+// Settles what stat alone can tell, true when the file has to be read
+static bool needs_hash(BuildDatabase* db, DatabaseEntry* entry) {
+    if (!stat_entry(db, entry)) {
+        entry -> current.hash = 0;
+        entry -> hash_state = HashKnown;
+        return false;
+    }
+
+    if (file_unchanged(entry)) {
+        entry -> current.hash = entry -> file -> hash;
+        entry -> hash_state = HashKnown;
+        return false;
+    }
+
+    return true;
+}
+
+uint64_t database_content_hash(BuildDatabase* db, uint32_t id) {
+    DatabaseEntry* entry = &db -> entries[id];
+
+    if (entry -> hash_state == HashKnown || !needs_hash(db, entry)) {
+        return entry -> current.hash;
+    }
+
+    char buffer[PATH_MAX];
+    uint64_t hash = 0;
+
+    if (hash_file(resolve(db, entry -> key, buffer, sizeof(buffer)), 0, &hash)) {
+        remember_hash(db, id, hash);
+    } else {
+        entry -> current.hash = 0;
+        entry -> hash_state = HashKnown;
+    }
+
+    return entry -> current.hash;
+}
+
+bool database_settled(BuildDatabase* db, uint32_t id, int64_t since_ns) {
+    const DatabaseEntry* entry = &db -> entries[id];
+    if (entry -> hash_state != HashKnown || entry -> stat_state != StatPresent) return false;
+
+    char buffer[PATH_MAX];
+    struct stat st;
+
+    if (stat(resolve(db, entry -> key, buffer, sizeof(buffer)), &st) != 0) return false;
+
+    return (uint64_t) st.st_size == entry -> current.size
+        && timespec_ns(&st.st_mtim) == entry -> current.mtime_ns
+        && timespec_ns(&st.st_ctim) == entry -> current.ctime_ns
+        && (uint64_t) st.st_ino == entry -> current.inode
+        && entry -> current.mtime_ns < since_ns;
+}
+
+uint64_t database_input_hash(BuildDatabase* db, const uint32_t* ids, uint32_t count) {
+    uint64_t hash = HASH_SEED;
+
+    for (uint32_t i = 0; i < count; i++) {
+        const uint64_t content = database_content_hash(db, ids[i]);
+        hash = hash_bytes(hash, &content, sizeof(content));
+    }
+
+    return hash;
+}
+
+typedef struct {
+    const BuildDatabase* db;
+    const uint32_t* ids;
+    uint64_t* hashes;
+    bool* read;
+} HashBatch;
+
+static void hash_batch_file(void* context, size_t index) {
+    HashBatch* batch = context;
+    const DatabaseEntry* entry = &batch -> db -> entries[batch -> ids[index]];
+    char buffer[PATH_MAX];
+
+    batch -> read[index] = hash_file(resolve(batch -> db, entry -> key, buffer, sizeof(buffer)), 0, &batch -> hashes[index]);
+}
+
+static void queue_hash(BuildDatabase* db, uint32_t id, uint32_t* queue, uint32_t* queued) {
+    DatabaseEntry* entry = &db -> entries[id];
+
+    if (entry -> hash_state != HashUnknown || !needs_hash(db, entry)) return;
+
+    entry -> hash_state = HashQueued;
+    queue[(*queued)++] = id;
+}
+
+// Planning asks for hashes one file at a time, so the reads are done up front: every path a
+// live record refers to is checked, and whatever changed since it was last hashed is read in
+// parallel. Stat calls are cheap and stay on this thread.
+void database_hash_files(BuildDatabase* db, uint32_t threads) {
+    if (!db -> content) return;
+
+    uint32_t* queue = arena_array(db -> scratch, uint32_t, db -> entry_count);
+    uint32_t queued = 0;
+
+    for (uint32_t id = 0; id < db -> entry_count; id++) {
+        const DatabaseRecord* record = db -> entries[id].record;
+        if (record == NULL) continue;
+
+        queue_hash(db, record -> output, queue, &queued);
+
+        for (uint32_t i = 0; i < record -> input_count; i++) {
+            queue_hash(db, record -> inputs[i], queue, &queued);
+        }
+    }
+
+    if (queued == 0) return;
+
+    HashBatch batch = {
+        .db = db,
+        .ids = queue,
+        .hashes = arena_array(db -> scratch, uint64_t, queued),
+        .read = arena_array(db -> scratch, bool, queued),
+    };
+
+    Whisker_Pool pool;
+    pool_init(&pool, threads < queued ? threads : queued);
+    pool_for(&pool, queued, hash_batch_file, &batch);
+    pool_destroy(&pool);
+
+    for (uint32_t i = 0; i < queued; i++) {
+        if (batch.read[i]) {
+            remember_hash(db, queue[i], batch.hashes[i]);
+        } else {
+            db -> entries[queue[i]].current.hash = 0;
+            db -> entries[queue[i]].hash_state = HashKnown;
+        }
+    }
+}
+
+void database_record(BuildDatabase* db, const char* output, char* const* inputs, uint32_t input_count, uint64_t command_hash, uint32_t duration_ms, uint32_t rss_kb) {
+    const uint32_t output_id = database_intern(db, output);
+
+    const size_t record_size = sizeof(DatabaseRecord) + input_count * sizeof(uint32_t);
+    DatabaseRecord* record = arena_alloc(db -> scratch, record_size);
+
+    for (uint32_t i = 0; i < input_count; i++) {
+        record -> inputs[i] = database_intern(db, inputs[i]);
+    }
+
+    struct stat st;
+    const bool exists = stat(output, &st) == 0;
+    uint64_t output_hash = 0;
+    const bool hashed = exists && hash_file(output, 0, &output_hash);
+
+    record -> output = output_id;
+    record -> input_count = input_count;
+    record -> command_hash = command_hash;
+    record -> output_hash = output_hash;
+    record -> input_hash = db -> content ? database_input_hash(db, record -> inputs, input_count) : 0;
+    record -> output_mtime_ns = exists ? timespec_ns(&st.st_mtim) : 0;
+    record -> duration_ms = duration_ms;
+    record -> rss_kb = rss_kb;
+
+    DatabaseEntry* entry = &db -> entries[output_id];
+
+    if (entry -> record != NULL) {
+        db -> dead++;
+    } else {
+        db -> live++;
+    }
+
+    entry -> record = record;
+    entry -> stat_state = StatUnknown;
+    entry -> hash_state = HashUnknown;
+
+    // The output was just read, so later jobs and builds need not read it again
+    if (db -> content && hashed) {
+        fill_stat(entry, &st);
+        remember_hash(db, output_id, output_hash);
+    }
+
+    if (db -> fd < 0) return;
+
+    flush(db, record, record_size);
+}
+
+// Paths are hashed the way they are stored, so a build started from a subdirectory
+// produces the same hash as one started from the project root
+uint64_t database_hash_command(const BuildDatabase* db, char* const* argv) {
+    uint64_t hash = HASH_SEED;
+
+    for (char* const* arg = argv; *arg != NULL; arg++) {
+        hash = hash_string(hash, normalize(db, *arg));
+    }
+
+    return hash;
+}
+
+uint32_t database_duration(const BuildDatabase* db, const char* output) {
+    const DatabaseRecord* record = database_find(db, output);
+    return record != NULL ? record -> duration_ms : 0;
+}
+
+uint32_t database_rss(const BuildDatabase* db, const char* output) {
+    const DatabaseRecord* record = database_find(db, output);
+    return record != NULL ? record -> rss_kb : 0;
+}
@@ -0,0 +1,135 @@
+#ifndef DATABASE_H
+#define DATABASE_H
+
+#include "../config/config.h"
+#include "../utils/arena.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/stat.h>
+#include <time.h>
+
+#define DATABASE_FILE ".catalyze_db"
+
+/*
+ *  Persistent build database, <build_dir>/.catalyze_db
+ *
+ *  An append-only log of 8 byte aligned records behind a 16 byte header. Path records intern
+ *  a path (relative to the project root unless absolute), their position in the log is their
+ *  id. Output records describe the last successful run of a job: its inputs as path ids,
+ *  the hash of its command line, the hash and mtime of the file it produced, the combined
+ *  content hash of its inputs, how long it took and its peak RSS. File records remember the
+ *  stat data a file had when its content was last hashed, so a file is only read again once
+ *  that changed. A later record for the same output or file supersedes the earlier one.
+ *
+ *  The file is mmapped, records are used in place and only the indexes live in the arena.
+ *  Every finished job appends its records with a single write, once superseded records
+ *  outnumber live ones the log is rewritten without them when the database is closed or
+ *  unlocked.
+ */
+
+typedef struct {
+    uint32_t output;
+    uint32_t input_count;
+    uint64_t command_hash;
+    uint64_t output_hash;
+    uint64_t input_hash;
+    int64_t output_mtime_ns;
+    uint32_t duration_ms;
+    uint32_t rss_kb;
+    uint32_t inputs[];
+} DatabaseRecord;
+
+typedef struct {
+    uint32_t path;
+    uint32_t reserved;
+    uint64_t size;
+    int64_t mtime_ns;
+    int64_t ctime_ns;
+    uint64_t inode;
+    uint64_t hash;
+} DatabaseFile;
+
+typedef struct {
+    const char* key;
+    const DatabaseRecord* record;
+    const DatabaseFile* file;
+    DatabaseFile current;
+    struct timespec mtime;
+    uint8_t stat_state;
+    uint8_t hash_state;
+} DatabaseEntry;
+
+typedef struct {
+    ArenaAllocator* arena;
+    ArenaAllocator* scratch;
+    const char* path;
+    const char* prefix;
+    size_t prefix_len;
+    uint8_t* map;
+    size_t map_size;
+    size_t valid_size;
+    DatabaseEntry* entries;
+    uint32_t entry_count;
+    uint32_t entry_capacity;
+    uint32_t persisted;
+    uint32_t* index;
+    uint32_t index_mask;
+    uint32_t* dirty;
+    uint32_t dirty_count;
+    uint32_t dirty_capacity;
+    uint32_t live;
+    uint32_t dead;
+    struct stat released;
+    int fd;
+    bool locked;
+    bool content;
+} BuildDatabase;
+
+void database_open(ArenaAllocator* arena, BuildDatabase* db, const CatalyzeConfig* config);
+void database_close(BuildDatabase* db);
+
+// A database stays loaded across builds without holding the build directory lock in between.
+// While locked, what a single build needs is allocated from 'scratch', which can be reset once
+// unlocked. Unlocking writes what is still pending and compacts the log when due, true when that
+// gave every path a new id. Locking again gives false, and leaves it unlocked, when another build
+// changed the file meanwhile: everything loaded is stale and it has to be reopened.
+bool database_unlock(BuildDatabase* db);
+bool database_lock(BuildDatabase* db, ArenaAllocator* scratch);
+
+// Paths are given as seen from the working directory, the database stores them project relative.
+// A lookup of a path that was never interned gives UINT32_MAX.
+uint32_t database_intern(BuildDatabase* db, const char* path);
+uint32_t database_lookup(const BuildDatabase* db, const char* path);
+const char* database_normalize(const BuildDatabase* db, const char* path);
+const char* database_path(const BuildDatabase* db, uint32_t id);
+const DatabaseRecord* database_find(const BuildDatabase* db, const char* path);
+
+// Cached stat() by path id, false when the file does not exist
+bool database_mtime(BuildDatabase* db, uint32_t id, struct timespec* mtime);
+
+// Drops the cached stat and hash of a path that changed on disk, the next query looks at it again
+void database_forget(BuildDatabase* db, uint32_t id);
+
+// Cached content hash by path id, 0 when the file cannot be read. The file is only read when
+// its stat data differs from the last file record.
+uint64_t database_content_hash(BuildDatabase* db, uint32_t id);
+
+// True when a freshly taken stat still matches the one the content hash was taken with, and the
+// file was last modified before since_ns (CLOCK_REALTIME). A file that is racing a compile fails.
+bool database_settled(BuildDatabase* db, uint32_t id, int64_t since_ns);
+
+// Combined content hash of a list of path ids, in order
+uint64_t database_input_hash(BuildDatabase* db, const uint32_t* ids, uint32_t count);
+
+// Content mode only: hashes every changed file the live records refer to, spread over threads
+void database_hash_files(BuildDatabase* db, uint32_t threads);
+
+void database_record(BuildDatabase* db, const char* output, char* const* inputs, uint32_t input_count, uint64_t command_hash, uint32_t duration_ms, uint32_t rss_kb);
+
+uint64_t database_hash_command(const BuildDatabase* db, char* const* argv);
+
+uint32_t database_duration(const BuildDatabase* db, const char* output);
+uint32_t database_rss(const BuildDatabase* db, const char* output);
+
+#endif // !DATABASE_H
@@ -18,9 +18,7 @@ void debug_err(const char* msg) {
     exit(1);
 }
 
-static void run_debug_target(ArenaAllocator* arena, CatalyzeConfig* config, const char* name, const char* dir, const char* file) {
-    build_project_target(arena, config, name);
-
+static void run_debug_target(CatalyzeConfig* config, const char* name, const char* dir, const char* file) {
     Whisker_Cmd cmd = {0};
 
     const char* path_prefix = config -> prefix;
@@ -39,31 +37,46 @@ static void run_debug_target(ArenaAllocator* arena, CatalyzeConfig* config, cons
     cmd_destroy(&cmd);
 }
 
+// Every debug target is built in one go before the first one runs
 void debug_all(ArenaAllocator* arena, CatalyzeConfig* config) {
+    const char* names[MAX_TARGETS];
     uint8_t count = 0;
 
     for (uint8_t i = 0; i < config -> target_count; i++) {
-        Target target  = config -> targets[i];
-        if (target.type == Debug) {
-            run_debug_target(arena, config, target.name, target.output_dir, target.output_name);
-            count++;
+        if (config -> targets[i].type == Debug) {
+            names[count++] = config -> targets[i].name;
         }
     }
 
     if (UNLIKELY(count == 0)) {
         debug_err("No debug targets found");
     } 
+
+    debug_targets(arena, config, names, count);
 }
 
-void debug_target(ArenaAllocator* arena, CatalyzeConfig* config, const char* name) {
-    for (uint8_t i = 0; i < config -> target_count; i++) {
-        Target target  = config -> targets[i];
-        if (target.type != Debug && strcmp(target.name, name) == 0) {
+void debug_targets(ArenaAllocator* arena, CatalyzeConfig* config, const char* const* names, uint8_t name_count) {
+    uint8_t indices[MAX_TARGETS];
+
+    for (uint8_t n = 0; n < name_count; n++) {
+        uint8_t i = 0;
+        while (i < config -> target_count && strcmp(config -> targets[i].name, names[n]) != 0) i++;
+
+        if (UNLIKELY(i == config -> target_count)) {
+            debug_err("Target not found");
+        }
+
+        if (UNLIKELY(config -> targets[i].type != Debug)) {
             debug_err("Target is not of debug type");
-        } else if (target.type != Debug && strcmp(target.name, name) == 0) {
-            run_debug_target(arena, config, target.name, target.output_dir, target.output_name);
         }
+
+        indices[n] = i;
     }
 
-    debug_err("Target not found");
+    build_project_targets(arena, config, names, name_count);
+
+    for (uint8_t n = 0; n < name_count; n++) {
+        const Target* target = &config -> targets[indices[n]];
+        run_debug_target(config, target -> name, target -> output_dir, target -> output_name);
+    }
 }
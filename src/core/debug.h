@@ -4,7 +4,9 @@
 #include "../utils/arena.h"
 #include "../config/config.h"
 
+#include <stdint.h>
+
 void debug_all(ArenaAllocator* arena, CatalyzeConfig* config); 
-void debug_target(ArenaAllocator* arena, CatalyzeConfig* config, const char* name); 
+void debug_targets(ArenaAllocator* arena, CatalyzeConfig* config, const char* const* names, uint8_t name_count); 
 
 #endif // !DEBUG_H
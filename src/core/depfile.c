@@ -0,0 +1,122 @@
+#include "depfile.h"
+
+#include "../utils/macros.h"
+
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static char* read_depfile(ArenaAllocator* arena, const char* path, size_t* size) {
+    int fd = open(path, O_RDONLY);
+    if (fd == -1) return NULL;
+
+    struct stat st;
+    if (UNLIKELY(fstat(fd, &st) == -1)) {
+        close(fd);
+        return NULL;
+    }
+
+    char* buffer = arena_alloc(arena, st.st_size + 1);
+    ssize_t bytes_read = 0;
+
+    while (bytes_read < st.st_size) {
+        ssize_t n = read(fd, buffer + bytes_read, st.st_size - bytes_read);
+        if (n <= 0) break;
+
+        bytes_read += n;
+    }
+
+    close(fd);
+    buffer[bytes_read] = 0;
+    *size = (size_t) bytes_read;
+
+    return buffer;
+}
+
+bool depfile_load(ArenaAllocator* arena, const char* path, Depfile* depfile) {
+    size_t size = 0;
+    char* buffer = read_depfile(arena, path, &size);
+    if (buffer == NULL) return false;
+
+    char* cursor = buffer;
+    char* end = buffer + size;
+
+    // The target may contain escaped spaces but never an unescaped ':'
+    while (cursor < end && *cursor != ':') {
+        cursor += *cursor == '\\' && cursor + 1 < end ? 2 : 1;
+    }
+
+    if (UNLIKELY(cursor >= end)) return false;
+    cursor++;
+
+    // Every path takes at least one character and one separator
+    depfile -> paths = arena_array(arena, char*, (end - cursor) / 2 + 1);
+    depfile -> count = 0;
+
+    // Unescaping only ever shrinks a path, so it is rewritten in place behind the cursor
+    char* write = cursor;
+    char* token = NULL;
+
+    while (cursor < end) {
+        const char c = *cursor;
+
+        if (c == '\\' && cursor + 1 < end) {
+            const char next = cursor[1];
+
+            if (next == '\n' || (next == '\r' && cursor + 2 < end && cursor[2] == '\n')) {
+                if (token != NULL) {
+                    *write++ = 0;
+                    depfile -> paths[depfile -> count++] = token;
+                    token = NULL;
+                }
+
+                cursor += next == '\n' ? 2 : 3;
+                continue;
+            }
+
+            if (next == ' ' || next == '#') {
+                if (token == NULL) token = write;
+
+                *write++ = next;
+                cursor += 2;
+                continue;
+            }
+        }
+
+        if (c == '$' && cursor + 1 < end && cursor[1] == '$') {
+            if (token == NULL) token = write;
+
+            *write++ = '$';
+            cursor += 2;
+            continue;
+        }
+
+        // An unescaped newline ends the first rule
+        if (c == '\n') break;
+
+        if (c == ' ' || c == '\t' || c == '\r') {
+            if (token != NULL) {
+                *write++ = 0;
+                depfile -> paths[depfile -> count++] = token;
+                token = NULL;
+            }
+
+            cursor++;
+            continue;
+        }
+
+        if (token == NULL) token = write;
+
+        *write++ = c;
+        cursor++;
+    }
+
+    if (token != NULL) {
+        *write = 0;
+        depfile -> paths[depfile -> count++] = token;
+    }
+
+    return true;
+}
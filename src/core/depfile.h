@@ -0,0 +1,27 @@
+#ifndef DEPFILE_H
+#define DEPFILE_H
+
+#include "../utils/arena.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ *  Make style dependency files, as written by -MMD -MF
+ *
+ *      build/main.o: src/main.c src/include/my\ header.h \
+ *        src/util.h
+ *
+ *  Only the first rule is read, -MP phony targets after it are ignored. Escaped spaces,
+ *  escaped '#', '$$' and backslash-newline continuations are undone in place.
+ */
+
+typedef struct {
+    char** paths;
+    uint32_t count;
+} Depfile;
+
+// False when the file is missing or malformed, the object then has to be rebuilt anyway
+bool depfile_load(ArenaAllocator* arena, const char* path, Depfile* depfile);
+
+#endif // !DEPFILE_H
@@ -0,0 +1,54 @@
+#include "graph.h"
+
+#include "../utils/macros.h"
+
+#include <stdint.h>
+#include <string.h>
+
+static void* grow(ArenaAllocator* arena, void* ptr, const size_t old_size, const size_t new_size) {
+    void* result = arena_alloc(arena, new_size);
+
+    if (old_size != 0) {
+        arena_memcpy(result, ptr, old_size);
+    }
+
+    return result;
+}
+
+void graph_init(ArenaAllocator* arena, BuildGraph* graph, uint32_t capacity) {
+    graph -> capacity = capacity == 0 ? 16 : capacity;
+    graph -> jobs = arena_array(arena, Job, graph -> capacity);
+    graph -> count = 0;
+}
+
+uint32_t graph_add_job(ArenaAllocator* arena, BuildGraph* graph, JobKind kind, char** argv, const char* output) {
+    if (UNLIKELY(graph -> count == graph -> capacity)) {
+        const uint32_t capacity = graph -> capacity * 2;
+        graph -> jobs = grow(arena, graph -> jobs, sizeof(Job) * graph -> capacity, sizeof(Job) * capacity);
+        graph -> capacity = capacity;
+    }
+
+    const uint32_t index = graph -> count++;
+    Job* job = &graph -> jobs[index];
+
+    memset(job, 0, sizeof(*job));
+    job -> kind = kind;
+    job -> argv = argv;
+    job -> output = output;
+
+    return index;
+}
+
+// `to` may only start once `from` has finished
+void graph_add_edge(ArenaAllocator* arena, BuildGraph* graph, uint32_t from, uint32_t to) {
+    Job* job = &graph -> jobs[from];
+
+    if (job -> dependent_count == job -> dependent_capacity) {
+        const uint32_t capacity = job -> dependent_capacity == 0 ? 4 : job -> dependent_capacity * 2;
+        job -> dependents = grow(arena, job -> dependents, sizeof(uint32_t) * job -> dependent_capacity, sizeof(uint32_t) * capacity);
+        job -> dependent_capacity = capacity;
+    }
+
+    job -> dependents[job -> dependent_count++] = to;
+    graph -> jobs[to].pending++;
+}
@@ -0,0 +1,71 @@
+#ifndef GRAPH_H
+#define GRAPH_H
+
+#include "../utils/arena.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#define NO_JOB UINT32_MAX
+
+typedef enum {
+    JobCompile,
+    JobLink
+} JobKind;
+
+typedef enum {
+    JobWaiting,
+    JobRunning,
+    JobRestoring,
+    JobDone,
+    JobFailed,
+    JobSkipped
+} JobState;
+
+typedef struct OutputChunk OutputChunk;
+
+typedef struct {
+    char** argv;
+    char** preprocess_argv;
+    const char* output;
+    const char* depfile;
+    const char* preprocessed;
+    char** inputs;
+    uint32_t input_count;
+    uint32_t* dependents;
+    uint32_t dependent_count;
+    uint32_t dependent_capacity;
+    uint32_t pending;
+    uint32_t estimate_ms;
+    uint32_t rss_kb;
+    uint64_t priority;
+    uint64_t started_ns;
+    uint64_t cache_key;
+    OutputChunk* output_head;
+    OutputChunk* output_tail;
+    int output_fd;
+    pid_t pid;
+    JobKind kind;
+    JobState state;
+    bool timed_out;
+    bool preprocessing;
+    bool direct;
+    bool cached;
+    bool cutoff;
+    bool inputs_changed;
+    bool same_output;
+} Job;
+
+typedef struct {
+    Job* jobs;
+    uint32_t count;
+    uint32_t capacity;
+} BuildGraph;
+
+void graph_init(ArenaAllocator* arena, BuildGraph* graph, uint32_t capacity);
+
+uint32_t graph_add_job(ArenaAllocator* arena, BuildGraph* graph, JobKind kind, char** argv, const char* output);
+void graph_add_edge(ArenaAllocator* arena, BuildGraph* graph, uint32_t from, uint32_t to);
+
+#endif // !GRAPH_H
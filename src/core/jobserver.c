@@ -0,0 +1,206 @@
+#include "jobserver.h"
+
+#include "../config/config.h"
+#include "../utils/macros.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+typedef struct {
+    int read_fd;
+    int write_fd;
+    bool initialised;
+    bool owner;
+    pid_t owner_pid;
+    char fifo_dir[PATH_MAX - 8];
+    char fifo_path[PATH_MAX];
+    uint32_t held;
+    char tokens[MAX_JOBS];
+} Jobserver;
+
+static Jobserver jobserver = { .read_fd = -1, .write_fd = -1 };
+
+static void jobserver_shutdown(void) {
+    while (jobserver.held > 0) {
+        jobserver_release();
+    }
+
+    // A forked child exiting, like the one 'catalyze watch' parses config.cat in, leaves it alone
+    if (jobserver.owner && jobserver.owner_pid == getpid()) {
+        unlink(jobserver.fifo_path);
+        rmdir(jobserver.fifo_dir);
+    }
+}
+
+// Reopening through /proc gives us our own file description, so O_NONBLOCK does not leak
+// into make or any sibling that shares the inherited pipe. -1 when that is not possible.
+static int reopen_nonblocking(int fd, int flags) {
+    char path[32];
+    snprintf(path, sizeof(path), "/proc/self/fd/%d", fd);
+
+    return open(path, flags | O_NONBLOCK | O_CLOEXEC);
+}
+
+static bool join_pipe(const char* auth) {
+    char* end = NULL;
+    long read_fd = strtol(auth, &end, 10);
+    if (end == auth || *end != ',') return false;
+
+    const char* write_start = end + 1;
+    long write_fd = strtol(write_start, &end, 10);
+    if (end == write_start || read_fd < 0 || write_fd < 0) return false;
+
+    // make only passes the fds to recipes marked with '+'
+    if (fcntl((int) read_fd, F_GETFD) == -1 || fcntl((int) write_fd, F_GETFD) == -1) {
+        fprintf(stderr, "\033[1mWarning:\033[0m jobserver unavailable, add '+' to the parent make rule\n");
+        return false;
+    }
+
+    // A blocking read would stall the scheduler's event loop whenever make's tokens are all taken,
+    // and setting O_NONBLOCK on the shared pipe could break make's own blocking reads
+    const int fd = reopen_nonblocking((int) read_fd, O_RDONLY);
+
+    if (fd < 0) {
+        fprintf(stderr, "\033[1mWarning:\033[0m jobserver unavailable, its pipe cannot be reopened as non-blocking\n");
+        return false;
+    }
+
+    jobserver.read_fd = fd;
+    jobserver.write_fd = (int) write_fd;
+    return true;
+}
+
+static bool join_fifo(const char* path, size_t len) {
+    char fifo[PATH_MAX];
+    if (len >= sizeof(fifo)) return false;
+
+    memcpy(fifo, path, len);
+    fifo[len] = 0;
+
+    int fd = open(fifo, O_RDWR | O_NONBLOCK | O_CLOEXEC);
+    if (fd < 0) return false;
+
+    jobserver.read_fd = fd;
+    jobserver.write_fd = fd;
+    return true;
+}
+
+// The last --jobserver-auth (or pre 4.2 --jobserver-fds) in MAKEFLAGS wins
+static bool join_inherited(void) {
+    const char* makeflags = getenv("MAKEFLAGS");
+    if (makeflags == NULL) return false;
+
+    const char* auth = NULL;
+    const char* options[] = { "--jobserver-auth=", "--jobserver-fds=" };
+
+    for (size_t i = 0; i < 2 && auth == NULL; i++) {
+        const size_t option_len = strlen(options[i]);
+
+        for (const char* p = strstr(makeflags, options[i]); p != NULL; p = strstr(p + 1, options[i])) {
+            auth = p + option_len;
+        }
+    }
+
+    if (auth == NULL) return false;
+
+    const size_t len = strcspn(auth, " ");
+
+    if (strncmp(auth, "fifo:", 5) == 0) {
+        return join_fifo(auth + 5, len - 5);
+    }
+
+    return join_pipe(auth);
+}
+
+// The fifo lives in a fresh private directory, so no other user can put anything at its path first
+static void create_server(uint32_t jobs) {
+    const char* runtime_dir = getenv("XDG_RUNTIME_DIR");
+    if (runtime_dir == NULL || runtime_dir[0] == 0) {
+        runtime_dir = "/tmp";
+    }
+
+    const int len = snprintf(jobserver.fifo_dir, sizeof(jobserver.fifo_dir), "%s/catalyze-jobserver-XXXXXX", runtime_dir);
+    if (UNLIKELY(len < 0 || (size_t) len + 6 >= sizeof(jobserver.fifo_dir))) return;
+
+    if (UNLIKELY(mkdtemp(jobserver.fifo_dir) == NULL)) return;
+
+    snprintf(jobserver.fifo_path, sizeof(jobserver.fifo_path), "%s/fifo", jobserver.fifo_dir);
+
+    if (UNLIKELY(mkfifo(jobserver.fifo_path, 0600) != 0)) {
+        rmdir(jobserver.fifo_dir);
+        return;
+    }
+
+    int fd = open(jobserver.fifo_path, O_RDWR | O_NONBLOCK | O_CLOEXEC);
+    if (UNLIKELY(fd < 0)) {
+        unlink(jobserver.fifo_path);
+        rmdir(jobserver.fifo_dir);
+        return;
+    }
+
+    jobserver.read_fd = fd;
+    jobserver.write_fd = fd;
+    jobserver.owner = true;
+    jobserver.owner_pid = getpid();
+
+    for (uint32_t i = 1; i < jobs; i++) {
+        if (UNLIKELY(write(fd, "+", 1) != 1)) break;
+    }
+
+    const char* existing = getenv("MAKEFLAGS");
+    const size_t size = 64 + sizeof(jobserver.fifo_path) + (existing ? strlen(existing) : 0);
+
+    char makeflags[size];
+    snprintf(makeflags, size, "%s%s-j%u --jobserver-auth=fifo:%s", existing ? existing : "", existing ? " " : "", jobs, jobserver.fifo_path);
+    setenv("MAKEFLAGS", makeflags, 1);
+}
+
+void jobserver_init(uint32_t jobs) {
+    if (jobserver.initialised) return;
+    jobserver.initialised = true;
+
+    if (!join_inherited() && jobs > 1) {
+        create_server(jobs);
+    }
+
+    if (jobserver.read_fd >= 0) {
+        atexit(jobserver_shutdown);
+    }
+}
+
+bool jobserver_acquire(void) {
+    if (jobserver.read_fd < 0) return true;
+    if (UNLIKELY(jobserver.held == MAX_JOBS)) return false;
+
+    char token;
+    ssize_t n = read(jobserver.read_fd, &token, 1);
+
+    if (n != 1) return false;
+
+    jobserver.tokens[jobserver.held++] = token;
+    return true;
+}
+
+void jobserver_release(void) {
+    if (jobserver.read_fd < 0 || jobserver.held == 0) return;
+
+    const char token = jobserver.tokens[--jobserver.held];
+
+    while (write(jobserver.write_fd, &token, 1) < 0 && errno == EINTR);
+}
+
+uint32_t jobserver_held(void) {
+    return jobserver.held;
+}
+
+int jobserver_fd(void) {
+    return jobserver.read_fd;
+}
@@ -0,0 +1,25 @@
+#ifndef JOBSERVER_H
+#define JOBSERVER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ *  GNU make jobserver support
+ *
+ *  When MAKEFLAGS carries --jobserver-auth (fifo:PATH or R,W pipe form) catalyze joins that
+ *  jobserver, otherwise it creates a fifo jobserver of its own and exports it through MAKEFLAGS
+ *  so nested make invocations and -flto=jobserver links share the same job budget.
+ *
+ *  Every process owns one implicit job slot, each further concurrent job needs a token.
+ */
+
+void jobserver_init(uint32_t jobs);
+
+bool jobserver_acquire(void);
+void jobserver_release(void);
+
+uint32_t jobserver_held(void);
+int jobserver_fd(void);
+
+#endif // !JOBSERVER_H
@@ -0,0 +1,94 @@
+#include "pressure.h"
+
+#include "../utils/macros.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+// "some avg10=0.00 avg60=0.00 avg300=0.00 total=123" followed by the same line for "full"
+static bool read_psi(const char* path, uint64_t* some_us, uint64_t* full_us) {
+    FILE* fptr = fopen(path, "r");
+    if (fptr == NULL) return false;
+
+    char kind[8];
+    unsigned long long total = 0;
+    bool found = false;
+
+    while (fscanf(fptr, "%7s %*s %*s %*s total=%llu", kind, &total) == 2) {
+        if (kind[0] == 's') {
+            *some_us = total;
+            found = true;
+        } else if (kind[0] == 'f' && full_us != NULL) {
+            *full_us = total;
+        }
+    }
+
+    fclose(fptr);
+    return found;
+}
+
+static double read_load(void) {
+    FILE* fptr = fopen("/proc/loadavg", "r");
+    if (fptr == NULL) return 0.0;
+
+    double load = 0.0;
+    if (fscanf(fptr, "%lf", &load) != 1) {
+        load = 0.0;
+    }
+
+    fclose(fptr);
+    return load;
+}
+
+static inline double stall_fraction(uint64_t current_us, uint64_t previous_us, uint64_t elapsed_ns) {
+    if (current_us <= previous_us) return 0.0;
+
+    const double fraction = (double) (current_us - previous_us) * 1000.0 / (double) elapsed_ns;
+    return fraction > 1.0 ? 1.0 : fraction;
+}
+
+void pressure_init(PressureMonitor* monitor, uint32_t cpus) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    monitor -> cpu_some_us = 0;
+    monitor -> memory_some_us = 0;
+    monitor -> memory_full_us = 0;
+    monitor -> sampled_ns = (uint64_t) ts.tv_sec * 1000000000ull + (uint64_t) ts.tv_nsec;
+    monitor -> cpus = cpus == 0 ? 1 : cpus;
+    monitor -> psi = read_psi("/proc/pressure/cpu", &monitor -> cpu_some_us, NULL)
+        && read_psi("/proc/pressure/memory", &monitor -> memory_some_us, &monitor -> memory_full_us);
+}
+
+bool pressure_sample(PressureMonitor* monitor, PressureSample* sample, uint64_t now_ns) {
+    const uint64_t elapsed_ns = now_ns - monitor -> sampled_ns;
+    if (UNLIKELY(now_ns <= monitor -> sampled_ns || elapsed_ns < 1000000)) return false;
+
+    sample -> cpu_some = 0.0;
+    sample -> memory_some = 0.0;
+    sample -> memory_full = 0.0;
+    sample -> load_per_cpu = read_load() / monitor -> cpus;
+
+    if (monitor -> psi) {
+        uint64_t cpu_some = monitor -> cpu_some_us;
+        uint64_t memory_some = monitor -> memory_some_us;
+        uint64_t memory_full = monitor -> memory_full_us;
+
+        read_psi("/proc/pressure/cpu", &cpu_some, NULL);
+        read_psi("/proc/pressure/memory", &memory_some, &memory_full);
+
+        sample -> cpu_some = stall_fraction(cpu_some, monitor -> cpu_some_us, elapsed_ns);
+        sample -> memory_some = stall_fraction(memory_some, monitor -> memory_some_us, elapsed_ns);
+        sample -> memory_full = stall_fraction(memory_full, monitor -> memory_full_us, elapsed_ns);
+
+        monitor -> cpu_some_us = cpu_some;
+        monitor -> memory_some_us = memory_some;
+        monitor -> memory_full_us = memory_full;
+    }
+
+    monitor -> sampled_ns = now_ns;
+    return true;
+}
@@ -0,0 +1,36 @@
+#ifndef PRESSURE_H
+#define PRESSURE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ *  System pressure sampling for adaptive concurrency
+ *
+ *  Reads the cumulative stall totals from /proc/pressure/{cpu,memory} (Linux PSI) and turns the
+ *  difference between two samples into the fraction of wall time tasks spent stalled. Kernels
+ *  without PSI only report the load average.
+ */
+
+typedef struct {
+    uint64_t cpu_some_us;
+    uint64_t memory_some_us;
+    uint64_t memory_full_us;
+    uint64_t sampled_ns;
+    uint32_t cpus;
+    bool psi;
+} PressureMonitor;
+
+typedef struct {
+    double cpu_some;
+    double memory_some;
+    double memory_full;
+    double load_per_cpu;
+} PressureSample;
+
+void pressure_init(PressureMonitor* monitor, uint32_t cpus);
+
+// Fills in the pressure since the previous sample, false when too little time has passed
+bool pressure_sample(PressureMonitor* monitor, PressureSample* sample, uint64_t now_ns);
+
+#endif // !PRESSURE_H
@@ -58,7 +58,7 @@ void run_project_target(ArenaAllocator* arena, CatalyzeConfig* config, const cha
         run_err("Target not found");
     }
 
-    build_project_target(arena, config, target_name);
+    build_project_targets(arena, config, &target_name, 1);
 
     Whisker_Cmd cmd = {0};
 
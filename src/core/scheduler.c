@@ -0,0 +1,1119 @@
+#define _GNU_SOURCE
+
+#include "scheduler.h"
+#include "cache.h"
+#include "depfile.h"
+#include "jobserver.h"
+#include "pressure.h"
+
+#include "../utils/macros.h"
+
+#define WHISKER_NOPREFIX
+#include "../../whisker/hash/whisker_hash.h"
+#include "../../whisker/loop/whisker_loop.h"
+#include "../../whisker/pool/whisker_pool.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <spawn.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/signalfd.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+extern char** environ;
+
+void scheduler_err(const char* msg) {
+    printf("\033[1mError:\033[0m %s\n", msg);
+    exit(1);
+}
+
+#define OUTPUT_CHUNK_SIZE 4096
+#define CANCEL_GRACE_MS 2000
+#define PRESSURE_INTERVAL_MS 500
+
+struct OutputChunk {
+    OutputChunk* next;
+    size_t len;
+    char data[OUTPUT_CHUNK_SIZE];
+};
+
+// Every job leads its own process group, so cancelling it also reaches the cc1/as/ld it forked.
+// Children start with the signal mask and dispositions we had before blocking SIGINT/SIGTERM.
+static void init_spawn_attributes(posix_spawnattr_t* attributes) {
+    sigset_t empty;
+    sigset_t defaults;
+
+    sigemptyset(&empty);
+    sigemptyset(&defaults);
+    sigaddset(&defaults, SIGINT);
+    sigaddset(&defaults, SIGTERM);
+
+    posix_spawnattr_init(attributes);
+    posix_spawnattr_setflags(attributes, POSIX_SPAWN_SETPGROUP | POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETSIGDEF);
+    posix_spawnattr_setpgroup(attributes, 0);
+    posix_spawnattr_setsigmask(attributes, &empty);
+    posix_spawnattr_setsigdefault(attributes, &defaults);
+}
+
+// stdout and stderr share one pipe, so a job's own output keeps its order
+static void spawn_job(Job* job, char** argv, const posix_spawnattr_t* attributes) {
+    int fds[2];
+    if (UNLIKELY(pipe2(fds, O_CLOEXEC) != 0)) {
+        scheduler_err("Failed to create output pipe");
+    }
+
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_adddup2(&actions, fds[1], STDOUT_FILENO);
+    posix_spawn_file_actions_adddup2(&actions, fds[1], STDERR_FILENO);
+
+    const int result = posix_spawnp(&job -> pid, argv[0], &actions, attributes, argv, environ);
+
+    posix_spawn_file_actions_destroy(&actions);
+    close(fds[1]);
+
+    if (UNLIKELY(result != 0)) {
+        close(fds[0]);
+        scheduler_err(job -> kind == JobLink ? "Failed to spawn linker" : "Failed to spawn compiler");
+    }
+
+    // Only our end is non-blocking, the compiler keeps ordinary blocking writes
+    fcntl(fds[0], F_SETFL, O_NONBLOCK);
+
+    job -> output_fd = fds[0];
+    job -> output_head = NULL;
+    job -> output_tail = NULL;
+}
+
+static void append_output(ArenaAllocator* arena, Job* job, const char* data, size_t len) {
+    while (len > 0) {
+        OutputChunk* chunk = job -> output_tail;
+
+        if (chunk == NULL || chunk -> len == OUTPUT_CHUNK_SIZE) {
+            chunk = arena_alloc(arena, sizeof(*chunk));
+            chunk -> next = NULL;
+            chunk -> len = 0;
+
+            if (job -> output_tail) {
+                job -> output_tail -> next = chunk;
+            } else {
+                job -> output_head = chunk;
+            }
+
+            job -> output_tail = chunk;
+        }
+
+        const size_t space = OUTPUT_CHUNK_SIZE - chunk -> len;
+        const size_t count = len < space ? len : space;
+
+        memcpy(chunk -> data + chunk -> len, data, count);
+        chunk -> len += count;
+        data += count;
+        len -= count;
+    }
+}
+
+// Reads whatever the pipe holds right now, returns false once the writer side is closed.
+// Silent jobs, which are most of them, never allocate a chunk.
+static bool drain_output(ArenaAllocator* arena, Job* job) {
+    if (job -> output_fd < 0) return false;
+
+    char buffer[OUTPUT_CHUNK_SIZE];
+
+    while (true) {
+        ssize_t n = read(job -> output_fd, buffer, sizeof(buffer));
+
+        if (n > 0) {
+            append_output(arena, job, buffer, (size_t) n);
+            continue;
+        }
+
+        if (n < 0 && errno == EINTR) continue;
+
+        return n < 0 && errno == EAGAIN;
+    }
+}
+
+static void close_output(Whisker_Loop* loop, Job* job) {
+    if (job -> output_fd < 0) return;
+
+    loop_remove_fd(loop, job -> output_fd);
+    close(job -> output_fd);
+    job -> output_fd = -1;
+}
+
+// One write per job, so diagnostics from parallel jobs never interleave
+static void print_output(const Job* job) {
+    for (const OutputChunk* chunk = job -> output_head; chunk != NULL; chunk = chunk -> next) {
+        fwrite(chunk -> data, 1, chunk -> len, stderr);
+    }
+
+    fflush(stderr);
+}
+
+// Every running job holds a pidfd and a pipe, make sure wide builds do not run out of fds
+static void raise_fd_limit(void) {
+    struct rlimit limit;
+
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max) {
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+}
+
+// cgroup v2 quota, "max 100000" when unlimited
+static uint32_t cgroup_cpu_limit(void) {
+    FILE* fptr = fopen("/sys/fs/cgroup/cpu.max", "r");
+    if (fptr == NULL) return 0;
+
+    char quota[32];
+    unsigned long period = 0;
+    int matched = fscanf(fptr, "%31s %lu", quota, &period);
+    fclose(fptr);
+
+    if (matched != 2 || period == 0 || quota[0] == 'm') return 0;
+
+    const unsigned long limit = (strtoul(quota, NULL, 10) + period - 1) / period;
+    return limit == 0 ? 1 : (uint32_t) limit;
+}
+
+uint32_t scheduler_default_jobs(void) {
+    uint32_t cpus = 0;
+
+    cpu_set_t set;
+    if (LIKELY(sched_getaffinity(0, sizeof(set), &set) == 0)) {
+        cpus = (uint32_t) CPU_COUNT(&set);
+    }
+
+    if (UNLIKELY(cpus == 0)) {
+        long online = sysconf(_SC_NPROCESSORS_ONLN);
+        cpus = online > 0 ? (uint32_t) online : 1;
+    }
+
+    const uint32_t quota = cgroup_cpu_limit();
+    if (quota != 0 && quota < cpus) {
+        cpus = quota;
+    }
+
+    return cpus;
+}
+
+// Bytes left under the cgroup v2 memory limit, 0 when there is none
+static uint64_t cgroup_memory_left(void) {
+    FILE* fptr = fopen("/sys/fs/cgroup/memory.max", "r");
+    if (fptr == NULL) return 0;
+
+    unsigned long long limit = 0;
+    int matched = fscanf(fptr, "%llu", &limit);
+    fclose(fptr);
+
+    if (matched != 1) return 0;
+
+    unsigned long long current = 0;
+    fptr = fopen("/sys/fs/cgroup/memory.current", "r");
+    if (fptr != NULL) {
+        if (fscanf(fptr, "%llu", &current) != 1) current = 0;
+        fclose(fptr);
+    }
+
+    return current < limit ? limit - current : 1;
+}
+
+// Three quarters of what the kernel reports as available, leaving room for the page cache
+// and for whatever else runs on the machine
+uint64_t scheduler_default_memory(void) {
+    uint64_t available_kb = 0;
+
+    FILE* fptr = fopen("/proc/meminfo", "r");
+    if (fptr != NULL) {
+        char line[128];
+
+        while (fgets(line, sizeof(line), fptr) != NULL) {
+            unsigned long long value = 0;
+
+            if (sscanf(line, "MemAvailable: %llu kB", &value) == 1) {
+                available_kb = value;
+                break;
+            }
+        }
+
+        fclose(fptr);
+    }
+
+    const uint64_t cgroup_kb = cgroup_memory_left() / 1024;
+    if (cgroup_kb != 0 && (available_kb == 0 || cgroup_kb < available_kb)) {
+        available_kb = cgroup_kb;
+    }
+
+    return available_kb / 4 * 3;
+}
+
+static inline uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ull + (uint64_t) ts.tv_nsec;
+}
+
+typedef struct {
+    uint32_t* items;
+    uint32_t count;
+} ReadyHeap;
+
+// Longest remaining critical path first, ties keep the order jobs were planned in
+static inline bool runs_before(const Job* jobs, uint32_t a, uint32_t b) {
+    if (jobs[a].priority != jobs[b].priority) {
+        return jobs[a].priority > jobs[b].priority;
+    }
+
+    return a < b;
+}
+
+static void heap_push(ReadyHeap* heap, const Job* jobs, uint32_t index) {
+    uint32_t i = heap -> count++;
+
+    while (i > 0) {
+        const uint32_t parent = (i - 1) / 2;
+        if (!runs_before(jobs, index, heap -> items[parent])) break;
+
+        heap -> items[i] = heap -> items[parent];
+        i = parent;
+    }
+
+    heap -> items[i] = index;
+}
+
+static uint32_t heap_pop(ReadyHeap* heap, const Job* jobs) {
+    const uint32_t top = heap -> items[0];
+    const uint32_t last = heap -> items[--heap -> count];
+
+    uint32_t i = 0;
+    while (true) {
+        uint32_t child = 2 * i + 1;
+        if (child >= heap -> count) break;
+
+        if (child + 1 < heap -> count && runs_before(jobs, heap -> items[child + 1], heap -> items[child])) {
+            child++;
+        }
+
+        if (!runs_before(jobs, heap -> items[child], last)) break;
+
+        heap -> items[i] = heap -> items[child];
+        i = child;
+    }
+
+    heap -> items[i] = last;
+    return top;
+}
+
+// Jobs without a record are estimated at the mean of their kind. The priority of a job is the
+// longest estimated path from its start to the end of the build (its bottom level).
+static uint64_t assign_priorities(ArenaAllocator* arena, BuildGraph* graph, const BuildDatabase* db, uint32_t* known) {
+    Job* jobs = graph -> jobs;
+    const uint32_t job_count = graph -> count;
+
+    uint64_t totals[2] = {0};
+    uint32_t counts[2] = {0};
+
+    for (uint32_t i = 0; i < job_count; i++) {
+        jobs[i].estimate_ms = database_duration(db, jobs[i].output);
+
+        if (jobs[i].estimate_ms != 0) {
+            totals[jobs[i].kind] += jobs[i].estimate_ms;
+            counts[jobs[i].kind]++;
+        }
+    }
+
+    *known = counts[JobCompile] + counts[JobLink];
+
+    for (uint32_t i = 0; i < job_count; i++) {
+        if (jobs[i].estimate_ms != 0) continue;
+
+        const JobKind kind = jobs[i].kind;
+        jobs[i].estimate_ms = counts[kind] != 0 ? (uint32_t) (totals[kind] / counts[kind]) : 1;
+    }
+
+    uint32_t* order = arena_array(arena, uint32_t, job_count);
+    uint32_t* pending = arena_array(arena, uint32_t, job_count);
+    uint32_t head = 0;
+    uint32_t tail = 0;
+
+    for (uint32_t i = 0; i < job_count; i++) {
+        pending[i] = jobs[i].pending;
+        if (pending[i] == 0) {
+            order[tail++] = i;
+        }
+    }
+
+    while (head < tail) {
+        const Job* job = &jobs[order[head++]];
+
+        for (uint32_t d = 0; d < job -> dependent_count; d++) {
+            if (--pending[job -> dependents[d]] == 0) {
+                order[tail++] = job -> dependents[d];
+            }
+        }
+    }
+
+    if (UNLIKELY(tail != job_count)) {
+        scheduler_err("Build graph has a dependency cycle");
+    }
+
+    uint64_t critical_path = 0;
+
+    for (uint32_t i = job_count; i-- > 0;) {
+        Job* job = &jobs[order[i]];
+        uint64_t longest = 0;
+
+        for (uint32_t d = 0; d < job -> dependent_count; d++) {
+            if (jobs[job -> dependents[d]].priority > longest) {
+                longest = jobs[job -> dependents[d]].priority;
+            }
+        }
+
+        job -> priority = job -> estimate_ms + longest;
+
+        if (job -> priority > critical_path) {
+            critical_path = job -> priority;
+        }
+    }
+
+    return critical_path;
+}
+
+// Peak RSS from the last run, jobs never seen before are assumed to need the average of their kind
+static void estimate_memory(Job* jobs, const uint32_t job_count, const BuildDatabase* db) {
+    uint64_t totals[2] = {0};
+    uint32_t counts[2] = {0};
+
+    for (uint32_t i = 0; i < job_count; i++) {
+        jobs[i].rss_kb = database_rss(db, jobs[i].output);
+
+        if (jobs[i].rss_kb != 0) {
+            totals[jobs[i].kind] += jobs[i].rss_kb;
+            counts[jobs[i].kind]++;
+        }
+    }
+
+    for (uint32_t i = 0; i < job_count; i++) {
+        if (jobs[i].rss_kb != 0) continue;
+
+        const JobKind kind = jobs[i].kind;
+        jobs[i].rss_kb = counts[kind] != 0 ? (uint32_t) (totals[kind] / counts[kind]) : 0;
+    }
+}
+
+// Replays the schedule with estimated durations to predict the makespan on `limit` slots
+static uint64_t simulate_makespan(ArenaAllocator* arena, const BuildGraph* graph, const uint32_t limit) {
+    const Job* jobs = graph -> jobs;
+    const uint32_t job_count = graph -> count;
+
+    uint32_t* pending = arena_array(arena, uint32_t, job_count);
+    ReadyHeap heap = { arena_array(arena, uint32_t, job_count), 0 };
+
+    for (uint32_t i = 0; i < job_count; i++) {
+        pending[i] = jobs[i].pending;
+        if (pending[i] == 0) {
+            heap_push(&heap, jobs, i);
+        }
+    }
+
+    uint32_t* slot_jobs = arena_array(arena, uint32_t, limit);
+    uint64_t* slot_ends = arena_array(arena, uint64_t, limit);
+    uint32_t busy = 0;
+    uint64_t now = 0;
+
+    while (heap.count > 0 || busy > 0) {
+        while (heap.count > 0 && busy < limit) {
+            const uint32_t index = heap_pop(&heap, jobs);
+
+            slot_jobs[busy] = index;
+            slot_ends[busy] = now + jobs[index].estimate_ms;
+            busy++;
+        }
+
+        uint32_t first = 0;
+        for (uint32_t i = 1; i < busy; i++) {
+            if (slot_ends[i] < slot_ends[first]) {
+                first = i;
+            }
+        }
+
+        const Job* job = &jobs[slot_jobs[first]];
+        now = slot_ends[first];
+
+        busy--;
+        slot_jobs[first] = slot_jobs[busy];
+        slot_ends[first] = slot_ends[busy];
+
+        for (uint32_t d = 0; d < job -> dependent_count; d++) {
+            if (--pending[job -> dependents[d]] == 0) {
+                heap_push(&heap, jobs, job -> dependents[d]);
+            }
+        }
+    }
+
+    return now;
+}
+
+static const char* failure_reason(const Job* job) {
+    if (job -> timed_out) {
+        return job -> kind == JobLink ? "Linking timed out:" : "Compilation timed out:";
+    }
+
+    return job -> kind == JobLink ? "Linking failed:" : "Compilation failed:";
+}
+
+static inline bool job_succeeded(const Job* job, const Whisker_Event* event) {
+    return !job -> timed_out && WIFEXITED(event -> status) && WEXITSTATUS(event -> status) == 0;
+}
+
+// Marks everything downstream of a failed job as skipped, returns how many jobs that was
+static uint32_t skip_dependents(Job* jobs, const Job* failed) {
+    uint32_t skipped = 0;
+
+    for (uint32_t i = 0; i < failed -> dependent_count; i++) {
+        Job* dependent = &jobs[failed -> dependents[i]];
+        if (dependent -> state == JobSkipped) continue;
+
+        dependent -> state = JobSkipped;
+        skipped += 1 + skip_dependents(jobs, dependent);
+    }
+
+    return skipped;
+}
+
+static void print_summary(const Job* jobs, const uint32_t job_count, const uint32_t failed, const uint32_t skipped) {
+    printf("\n\033[1mBuild failed:\033[0m %u job%s failed, %u skipped\n", failed, failed == 1 ? "" : "s", skipped);
+
+    for (uint32_t i = 0; i < job_count; i++) {
+        if (jobs[i].state != JobFailed) continue;
+
+        printf("    %s %s\n", failure_reason(&jobs[i]), jobs[i].output);
+    }
+}
+
+typedef struct {
+    PressureMonitor monitor;
+    uint32_t limit;
+    uint32_t min;
+    uint32_t max;
+    uint32_t lowest;
+    uint32_t highest;
+    bool slow_start;
+} AdaptiveLimit;
+
+static void adaptive_init(AdaptiveLimit* adaptive, const SchedulerOptions* options, uint32_t max) {
+    const uint32_t min = options -> min_jobs == 0 ? 1 : options -> min_jobs < max ? options -> min_jobs : max;
+
+    pressure_init(&adaptive -> monitor, scheduler_default_jobs());
+    adaptive -> limit = min;
+    adaptive -> min = min;
+    adaptive -> max = max;
+    adaptive -> lowest = min;
+    adaptive -> highest = min;
+    adaptive -> slow_start = true;
+}
+
+// AIMD: memory stalls halve the limit, CPU contention takes one job away, and a quiet machine
+// earns one more job, doubling until the first sign of contention. Growth only happens while
+// the limit is what holds jobs back, an idle limit tells nothing about the machine.
+static void adaptive_update(AdaptiveLimit* adaptive, const PressureSample* sample, bool saturated) {
+    uint32_t limit = adaptive -> limit;
+
+    if (sample -> memory_full > 0.05 || sample -> memory_some > 0.20) {
+        limit /= 2;
+        adaptive -> slow_start = false;
+    } else if (sample -> cpu_some > 0.40 || sample -> load_per_cpu > 1.5) {
+        limit -= 1;
+        adaptive -> slow_start = false;
+    } else if (saturated && sample -> cpu_some < 0.10 && sample -> memory_some < 0.05 && sample -> load_per_cpu < 1.0) {
+        limit = adaptive -> slow_start ? limit * 2 : limit + 1;
+    }
+
+    if (limit < adaptive -> min) limit = adaptive -> min;
+    if (limit > adaptive -> max) limit = adaptive -> max;
+
+    if (limit < adaptive -> lowest) adaptive -> lowest = limit;
+    if (limit > adaptive -> highest) adaptive -> highest = limit;
+
+    adaptive -> limit = limit;
+}
+
+// Compiles list their inputs in the depfile they just wrote, links and direct cache hits know them up front.
+// A compile whose depfile is unreadable is recorded without inputs, so it is rebuilt next time.
+// True when the output came out byte-identical to the one recorded before.
+static bool record_job(ArenaAllocator* arena, BuildDatabase* db, const Job* job, uint32_t duration_ms, uint32_t rss_kb) {
+    const uint64_t command_hash = database_hash_command(db, job -> argv);
+    const DatabaseRecord* previous = database_find(db, job -> output);
+    const uint64_t previous_hash = previous != NULL ? previous -> output_hash : 0;
+
+    if (job -> depfile != NULL && !job -> direct) {
+        Depfile depfile = {0};
+        depfile_load(arena, job -> depfile, &depfile);
+
+        database_record(db, job -> output, depfile.paths, depfile.count, command_hash, duration_ms, rss_kb);
+    } else {
+        database_record(db, job -> output, job -> inputs, job -> input_count, command_hash, duration_ms, rss_kb);
+    }
+
+    return previous_hash != 0 && database_find(db, job -> output) -> output_hash == previous_hash;
+}
+
+// A link whose rebuilt inputs all came out byte-identical would produce the same output again.
+// Decided once, when the link is next in line.
+static bool cut_off(BuildDatabase* db, Job* job) {
+    const DatabaseRecord* record = database_find(db, job -> output);
+
+    if (record == NULL) {
+        job -> cutoff = false;
+    } else if (db -> content && record -> input_hash != 0) {
+        job -> cutoff = database_input_hash(db, record -> inputs, record -> input_count) == record -> input_hash;
+    } else {
+        job -> cutoff = !job -> inputs_changed;
+    }
+
+    return job -> cutoff;
+}
+
+// The key stays on the job either way, a miss stores the object once the compile succeeded
+// and both point the direct manifest at it
+static bool restore_cached(ObjectCache* cache, const BuildDatabase* db, Job* job) {
+    uint64_t source_hash = 0;
+    const bool hashed = hash_file(job -> preprocessed, 0, &source_hash);
+    unlink(job -> preprocessed);
+
+    if (UNLIKELY(!hashed)) return false;
+
+    job -> cache_key = cache_key(cache, db, job -> argv, source_hash);
+    job -> cached = cache_restore(cache, job -> cache_key, job -> output, false);
+
+    return job -> cached;
+}
+
+// Only files that had settled before the job started can vouch for what it compiled
+static void store_direct(ObjectCache* cache, BuildDatabase* db, const Job* job) {
+    const DatabaseRecord* record = database_find(db, job -> output);
+    if (record == NULL || record -> input_count == 0) return;
+
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+
+    const int64_t since_ns = (int64_t) now.tv_sec * 1000000000ll + now.tv_nsec - (int64_t) (now_ns() - job -> started_ns);
+    cache_store_direct(cache, db, job -> argv, record -> inputs, record -> input_count, job -> cache_key, since_ns);
+}
+
+// Cache restores and stores run on worker threads. A restore hands the job's index back through
+// a pipe the loop watches, a store is only waited for at the end of the build.
+typedef struct {
+    ObjectCache* cache;
+    const BuildDatabase* db;
+    Job* jobs;
+    Whisker_Pool pool;
+    int done[2];
+    uint32_t pending;
+} CacheWorkers;
+
+static void restore_task(void* context, size_t index) {
+    CacheWorkers* workers = context;
+    Job* job = &workers -> jobs[index];
+
+    if (job -> direct) {
+        job -> cached = cache_restore(workers -> cache, job -> cache_key, job -> output, true);
+    } else {
+        restore_cached(workers -> cache, workers -> db, job);
+    }
+
+    const uint32_t id = (uint32_t) index;
+
+    // Four bytes are written atomically and the loop drains the pipe, so this cannot block for long
+    while (write(workers -> done[1], &id, sizeof(id)) < 0 && errno == EINTR) {}
+}
+
+static void workers_init(CacheWorkers* workers, Whisker_Loop* loop, ObjectCache* cache, const BuildDatabase* db, Job* jobs, uint32_t threads) {
+    workers -> cache = cache;
+    workers -> db = db;
+    workers -> jobs = jobs;
+    workers -> pending = 0;
+    workers -> done[0] = -1;
+    workers -> done[1] = -1;
+
+    if (!cache -> enabled) return;
+
+    // One more thread than workers, as the loop thread never takes part
+    if (UNLIKELY(!pool_init(&workers -> pool, threads + 1) && workers -> pool.thread_count == 0)) {
+        scheduler_err("Failed to start cache restore threads");
+    }
+
+    if (UNLIKELY(pipe2(workers -> done, O_CLOEXEC) != 0 || !loop_add_fd(loop, workers -> done[0], workers))) {
+        scheduler_err("Failed to watch cache restores");
+    }
+
+    fcntl(workers -> done[0], F_SETFL, O_NONBLOCK);
+}
+
+static void workers_restore(CacheWorkers* workers, Job* job) {
+    job -> state = JobRestoring;
+    workers -> pending++;
+
+    if (UNLIKELY(!pool_submit(&workers -> pool, restore_task, workers, (size_t) (job - workers -> jobs)))) {
+        scheduler_err("Failed to queue cache restore");
+    }
+}
+
+// Waits for restores still in flight, they only ever rename complete objects into place
+static void store_task(void* context, size_t index) {
+    CacheWorkers* workers = context;
+    const Job* job = &workers -> jobs[index];
+
+    cache_store(workers -> cache, job -> cache_key, job -> output);
+}
+
+static void workers_store(CacheWorkers* workers, const Job* job) {
+    if (UNLIKELY(!pool_submit(&workers -> pool, store_task, workers, (size_t) (job - workers -> jobs)))) {
+        scheduler_err("Failed to queue cache store");
+    }
+}
+
+static void workers_destroy(CacheWorkers* workers) {
+    if (workers -> done[0] < 0) return;
+
+    pool_destroy(&workers -> pool);
+    close(workers -> done[0]);
+    close(workers -> done[1]);
+}
+
+static void release_dependents(ReadyHeap* ready, Job* jobs, const Job* job) {
+    for (uint32_t i = 0; i < job -> dependent_count; i++) {
+        const uint32_t dependent = job -> dependents[i];
+        jobs[dependent].inputs_changed |= !job -> same_output;
+
+        if (--jobs[dependent].pending == 0) {
+            heap_push(ready, jobs, dependent);
+        }
+    }
+}
+
+// Kills every running job's process group, waits for them and removes whatever they left half-written.
+// Their output is dropped, only the error that caused the cancellation matters.
+static void cancel_jobs(Whisker_Loop* loop, Job* jobs, const uint32_t job_count, uint32_t running_count) {
+    for (uint32_t i = 0; i < job_count; i++) {
+        if (jobs[i].state != JobRunning) continue;
+
+        if (jobs[i].output_fd >= 0) {
+            close_output(loop, &jobs[i]);
+        }
+
+        kill(-jobs[i].pid, SIGTERM);
+    }
+
+    Whisker_Event events[64];
+    const uint64_t deadline = now_ns() + CANCEL_GRACE_MS * 1000000ull;
+    bool killed = false;
+
+    while (running_count > 0) {
+        const uint64_t now = now_ns();
+        const int wait_ms = killed ? -1 : now >= deadline ? 0 : (int) ((deadline - now) / 1000000ull);
+        const size_t event_count = loop_wait(loop, events, 64, wait_ms);
+
+        // Whatever ignored SIGTERM for the whole grace period gets no second chance
+        if (event_count == 0) {
+            for (uint32_t i = 0; i < job_count; i++) {
+                if (jobs[i].state == JobRunning) {
+                    kill(-jobs[i].pid, SIGKILL);
+                }
+            }
+
+            killed = true;
+            continue;
+        }
+
+        for (size_t e = 0; e < event_count; e++) {
+            Job* job = events[e].data;
+
+            // The signalfd and jobserver stay readable, stop watching them so the wait can block
+            if (events[e].kind == WHISKER_EVENT_READABLE) {
+                loop_remove_fd(loop, events[e].fd);
+                continue;
+            }
+
+            if (events[e].kind != WHISKER_EVENT_EXIT) continue;
+
+            job -> state = JobSkipped;
+            unlink(job -> output);
+            running_count--;
+
+            if (job -> preprocessing) {
+                unlink(job -> preprocessed);
+            }
+        }
+    }
+}
+
+bool scheduler_run(ArenaAllocator* arena, BuildGraph* graph, const SchedulerOptions* options, BuildDatabase* db, ObjectCache* cache) {
+    const uint32_t limit = options -> max_jobs == 0 ? 1 : options -> max_jobs;
+    const uint32_t job_count = graph -> count;
+    Job* jobs = graph -> jobs;
+
+    if (job_count == 0) return true;
+
+    uint32_t known = 0;
+    const uint64_t critical_path = assign_priorities(arena, graph, db, &known);
+    estimate_memory(jobs, job_count, db);
+
+    const uint64_t expected = simulate_makespan(arena, graph, limit);
+    const uint64_t build_start = now_ns();
+
+    ReadyHeap ready = { arena_array(arena, uint32_t, job_count), 0 };
+    uint32_t running_count = 0;
+    uint64_t running_rss_kb = 0;
+    uint32_t memory_waits = 0;
+    uint32_t held_job = NO_JOB;
+    uint32_t finished = 0;
+    uint32_t cut_off_count = 0;
+    uint32_t failed = 0;
+    uint32_t skipped = 0;
+
+    for (uint32_t i = 0; i < job_count; i++) {
+        if (jobs[i].pending == 0) {
+            heap_push(&ready, jobs, i);
+        }
+    }
+
+    jobserver_init(limit);
+    raise_fd_limit();
+
+    Whisker_Loop loop;
+    if (UNLIKELY(!loop_init(&loop))) {
+        scheduler_err("Failed to create event loop");
+    }
+
+    // SIGINT/SIGTERM arrive through the loop, so an interrupted build can still clean up after itself
+    sigset_t signals;
+    sigset_t previous_mask;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    sigprocmask(SIG_BLOCK, &signals, &previous_mask);
+
+    int signal_fd = signalfd(-1, &signals, SFD_NONBLOCK | SFD_CLOEXEC);
+    if (UNLIKELY(signal_fd < 0 || !loop_add_fd(&loop, signal_fd, &signal_fd))) {
+        scheduler_err("Failed to watch for signals");
+    }
+
+    posix_spawnattr_t attributes;
+    init_spawn_attributes(&attributes);
+
+    AdaptiveLimit adaptive = {0};
+    if (options -> adaptive) {
+        adaptive_init(&adaptive, options, limit);
+    }
+
+    uint32_t active_limit = options -> adaptive ? adaptive.limit : limit;
+
+    CacheWorkers workers;
+    workers_init(&workers, &loop, cache, db, jobs, limit);
+
+    Whisker_Event events[64];
+    bool watching_tokens = false;
+    bool cancelled = false;
+
+    while (LIKELY(finished < job_count && !cancelled)) {
+        bool waiting_for_token = false;
+
+        // A direct cache hit is a file copy and a cut off link is nothing at all, neither needs a slot or a token
+        while (ready.count > 0 && (jobs[ready.items[0]].direct || (jobs[ready.items[0]].cutoff && cut_off(db, &jobs[ready.items[0]])))) {
+            Job* job = &jobs[heap_pop(&ready, jobs)];
+
+            if (job -> direct) {
+                workers_restore(&workers, job);
+                continue;
+            }
+
+            // Newer than the inputs that were just rewritten, so the mtime check agrees next time
+            utimensat(AT_FDCWD, job -> output, NULL, 0);
+
+            job -> state = JobDone;
+            job -> same_output = record_job(arena, db, job, database_duration(db, job -> output), database_rss(db, job -> output));
+            finished++;
+            cut_off_count++;
+
+            release_dependents(&ready, jobs, job);
+        }
+
+        while (running_count < active_limit && ready.count > 0) {
+            // A job that would push the predicted peak over the budget waits for memory to free up,
+            // though one job always runs so a single huge translation unit cannot stall the build
+            const uint32_t next = ready.items[0];
+            if (running_count > 0 && options -> memory_kb != 0 && running_rss_kb + jobs[next].rss_kb > options -> memory_kb) {
+                if (held_job != next) {
+                    held_job = next;
+                    memory_waits++;
+                }
+
+                break;
+            }
+
+            // The first job runs on our implicit slot, every other one needs a token
+            if (running_count > jobserver_held() && !jobserver_acquire()) {
+                waiting_for_token = true;
+                break;
+            }
+
+            Job* job = &jobs[heap_pop(&ready, jobs)];
+            running_rss_kb += job -> rss_kb;
+            job -> state = JobRunning;
+            job -> started_ns = now_ns();
+
+            // A hardlinked object shares its inode with the cache entry, the compiler must not write through it
+            if (cache -> link && job -> kind == JobCompile && !job -> preprocessing) {
+                unlink(job -> output);
+            }
+
+            // 'ar rcs' updates an existing archive in place, so members of removed sources would stay.
+            // Every link writes its output from scratch.
+            if (job -> kind == JobLink) {
+                unlink(job -> output);
+            }
+
+            spawn_job(job, job -> preprocessing ? job -> preprocess_argv : job -> argv, &attributes);
+
+            if (UNLIKELY(!loop_add_child(&loop, job -> pid, options -> timeout_ms, job) || !loop_add_fd(&loop, job -> output_fd, job))) {
+                scheduler_err("Failed to watch job");
+            }
+
+            running_count++;
+        }
+
+        while (jobserver_held() > 0 && jobserver_held() >= running_count) {
+            jobserver_release();
+        }
+
+        // Only watch the jobserver while we want a token, it is readable most of the time
+        if (waiting_for_token != watching_tokens) {
+            if (waiting_for_token) {
+                loop_add_fd(&loop, jobserver_fd(), NULL);
+            } else {
+                loop_remove_fd(&loop, jobserver_fd());
+            }
+
+            watching_tokens = waiting_for_token;
+        }
+
+        if (UNLIKELY(running_count == 0 && workers.pending == 0)) {
+            if (finished == job_count) break;
+            scheduler_err("Build graph has a dependency cycle");
+        }
+
+        int wait_ms = -1;
+
+        if (options -> adaptive) {
+            const uint64_t now = now_ns();
+            const uint64_t due = adaptive.monitor.sampled_ns + PRESSURE_INTERVAL_MS * 1000000ull;
+            PressureSample sample;
+
+            if (now >= due && pressure_sample(&adaptive.monitor, &sample, now)) {
+                adaptive_update(&adaptive, &sample, running_count >= active_limit && ready.count > 0);
+                active_limit = adaptive.limit;
+                continue;
+            }
+
+            wait_ms = (int) ((due - now + 999999ull) / 1000000ull);
+        }
+
+        const size_t event_count = loop_wait(&loop, events, 64, wait_ms);
+
+        for (size_t e = 0; e < event_count && !cancelled; e++) {
+            Job* job = events[e].data;
+
+            if (UNLIKELY(events[e].data == &signal_fd)) {
+                struct signalfd_siginfo info;
+                if (read(signal_fd, &info, sizeof(info)) != sizeof(info)) continue;
+
+                printf("\n\033[1mInterrupted:\033[0m stopping %u running job%s\n", running_count, running_count == 1 ? "" : "s");
+                fflush(stdout);
+
+                cancel_jobs(&loop, jobs, job_count, running_count);
+                workers_destroy(&workers);
+                exit(128 + (int) info.ssi_signo);
+            }
+
+            if (events[e].data == &workers) {
+                uint32_t ids[64];
+                ssize_t n;
+
+                while ((n = read(workers.done[0], ids, sizeof(ids))) > 0) {
+                    for (size_t i = 0; i < (size_t) n / sizeof(uint32_t); i++) {
+                        Job* restored = &jobs[ids[i]];
+                        workers.pending--;
+
+                        // A failed direct restore goes back to preprocessing, a preprocessed miss compiles
+                        if (!restored -> cached) {
+                            if (restored -> direct) {
+                                restored -> direct = false;
+                                restored -> cache_key = 0;
+                            }
+
+                            restored -> state = JobWaiting;
+                            heap_push(&ready, jobs, ids[i]);
+                            continue;
+                        }
+
+                        print_output(restored);
+
+                        restored -> state = JobDone;
+                        finished++;
+
+                        // A direct hit keeps the timing of the compile it stands in for
+                        if (restored -> direct) {
+                            restored -> same_output = record_job(arena, db, restored, database_duration(db, restored -> output), database_rss(db, restored -> output));
+                        } else {
+                            restored -> same_output = record_job(arena, db, restored, (uint32_t) ((now_ns() - restored -> started_ns) / 1000000), restored -> rss_kb);
+                            store_direct(cache, db, restored);
+                        }
+
+                        release_dependents(&ready, jobs, restored);
+                    }
+                }
+
+                continue;
+            }
+
+            switch (events[e].kind) {
+                case WHISKER_EVENT_READABLE:
+                    if (job != NULL && !drain_output(arena, job)) {
+                        close_output(&loop, job);
+                    }
+
+                    break;
+
+                case WHISKER_EVENT_TIMEOUT:
+                    job -> timed_out = true;
+                    kill(-job -> pid, SIGKILL);
+                    break;
+
+                case WHISKER_EVENT_EXIT: {
+                    if (job -> output_fd >= 0) {
+                        drain_output(arena, job);
+                        close_output(&loop, job);
+                    }
+
+                    running_count--;
+                    running_rss_kb -= job -> rss_kb;
+
+                    // The preprocessed source decides whether the object is cached, a miss queues
+                    // the compile again and it takes a slot like any other job
+                    if (job -> preprocessing && job_succeeded(job, &events[e])) {
+                        job -> preprocessing = false;
+                        workers_restore(&workers, job);
+                        break;
+                    }
+
+                    print_output(job);
+                    finished++;
+
+                    if (UNLIKELY(!job_succeeded(job, &events[e]))) {
+                        job -> state = JobFailed;
+                        unlink(job -> output);
+
+                        if (job -> preprocessing) {
+                            unlink(job -> preprocessed);
+                        }
+
+                        if (!options -> keep_going) {
+                            printf("\033[1mError:\033[0m %s %s\n", failure_reason(job), job -> output);
+                            fflush(stdout);
+
+                            cancel_jobs(&loop, jobs, job_count, running_count);
+                            cancelled = true;
+                            break;
+                        }
+
+                        const uint32_t newly_skipped = skip_dependents(jobs, job);
+
+                        failed++;
+                        skipped += newly_skipped;
+                        finished += newly_skipped;
+                        break;
+                    }
+
+                    job -> state = JobDone;
+
+                    if (job -> cache_key != 0 && !job -> cached) {
+                        workers_store(&workers, job);
+                    }
+
+                    // ru_maxrss is in kilobytes and already covers cc1/ld, which the driver waited for
+                    job -> same_output = record_job(arena, db, job, (uint32_t) ((now_ns() - job -> started_ns) / 1000000), (uint32_t) events[e].usage.ru_maxrss);
+
+                    if (job -> cache_key != 0) {
+                        store_direct(cache, db, job);
+                    }
+
+                    release_dependents(&ready, jobs, job);
+                    break;
+                }
+            }
+        }
+    }
+
+    workers_destroy(&workers);
+    posix_spawnattr_destroy(&attributes);
+    loop_destroy(&loop);
+    close(signal_fd);
+    sigprocmask(SIG_SETMASK, &previous_mask, NULL);
+
+    if (UNLIKELY(cancelled)) {
+        return false;
+    }
+
+    const double actual = (double) (now_ns() - build_start) / 1000000000.0;
+
+    if (UNLIKELY(failed != 0)) {
+        print_summary(jobs, job_count, failed, skipped);
+        return false;
+    }
+
+    if (known != 0) {
+        printf("\n\033[1mSchedule:\033[0m %u jobs on %u slots, critical path %.3fs, expected makespan %.3fs, actual %.3fs\n",
+            job_count, limit, critical_path / 1000.0, expected / 1000.0, actual);
+    }
+
+    if (options -> adaptive) {
+        printf("\033[1mAdaptive:\033[0m job limit moved between %u and %u (allowed %u to %u), ended at %u\n",
+            adaptive.lowest, adaptive.highest, adaptive.min, adaptive.max, adaptive.limit);
+    }
+
+    if (cache -> hits + cache -> misses != 0) {
+        printf("\033[1mCache:\033[0m %u hit%s (%u direct), %u miss%s\n", cache -> hits, cache -> hits == 1 ? "" : "s", cache -> direct_hits, cache -> misses, cache -> misses == 1 ? "" : "es");
+    }
+
+    if (cache -> packed_in != 0) {
+        printf("\033[1mCompression:\033[0m stored %.1fM as %.1fM (%.2fx)\n",
+            cache -> packed_in / 1048576.0, cache -> packed_out / 1048576.0, (double) cache -> packed_in / (double) cache -> packed_out);
+    }
+
+    if (cache -> unpacked_bytes != 0) {
+        printf("\033[1mDecompression:\033[0m %.1fM at %.0f MB/s\n",
+            cache -> unpacked_bytes / 1048576.0, cache -> unpacked_bytes / 1048576.0 / ((double) cache -> unpack_ns / 1000000000.0));
+    }
+
+    if (cut_off_count != 0) {
+        printf("\033[1mCutoff:\033[0m %u link%s skipped, %s rebuilt inputs came out unchanged\n", cut_off_count, cut_off_count == 1 ? "" : "s", cut_off_count == 1 ? "its" : "their");
+    }
+
+    if (memory_waits != 0) {
+        printf("\033[1mMemory:\033[0m %u job%s waited for the %luM budget\n", memory_waits, memory_waits == 1 ? "" : "s", (unsigned long) (options -> memory_kb / 1024));
+    }
+
+    return true;
+}
@@ -0,0 +1,27 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include "cache.h"
+#include "graph.h"
+#include "database.h"
+
+#include "../utils/arena.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef struct {
+    uint32_t max_jobs;
+    uint32_t min_jobs;
+    uint32_t timeout_ms;
+    uint64_t memory_kb;
+    bool keep_going;
+    bool adaptive;
+} SchedulerOptions;
+
+uint32_t scheduler_default_jobs(void);
+uint64_t scheduler_default_memory(void);
+
+bool scheduler_run(ArenaAllocator* arena, BuildGraph* graph, const SchedulerOptions* options, BuildDatabase* db, ObjectCache* cache);
+
+#endif // !SCHEDULER_H
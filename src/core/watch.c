@@ -0,0 +1,358 @@
+#include "watch.h"
+
+#include "build.h"
+#include "database.h"
+
+#include "../utils/macros.h"
+#include "../utils/timer.h"
+
+#define WHISKER_NOPREFIX
+#include "../../whisker/loop/whisker_loop.h"
+
+#include <limits.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/inotify.h>
+#include <sys/signalfd.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// Editors save through a temporary file, a rename and a chmod, all within a few milliseconds
+#define WATCH_QUIET_MS 50
+#define WATCH_MASK (IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_CREATE | IN_DELETE | IN_ATTRIB | IN_ONLYDIR)
+
+typedef struct {
+    ArenaAllocator* arena;
+    const CatalyzeConfig* config;
+    BuildDatabase db;
+    int fd;
+    const char** dirs;
+    uint32_t dir_capacity;
+    uint32_t dir_count;
+    bool* inputs;
+    uint32_t input_capacity;
+} Watcher;
+
+static void watch_err(const char* msg) {
+    printf("\033[1mError:\033[0m %s\n", msg);
+    exit(1);
+}
+
+static void* grow(ArenaAllocator* arena, void* ptr, const size_t old_size, const size_t new_size) {
+    void* result = arena_memset(arena_alloc(arena, new_size), 0, new_size);
+
+    if (old_size != 0) {
+        arena_memcpy(result, ptr, old_size);
+    }
+
+    return result;
+}
+
+// 'dir' is project relative, its first 'len' bytes name the directory and none the root
+static void watch_dir(Watcher* watcher, const char* dir, size_t len) {
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), "%s%.*s", watcher -> config -> prefix, (int) len, dir);
+
+    // Adding a directory twice gives back its existing descriptor
+    const int wd = inotify_add_watch(watcher -> fd, path, WATCH_MASK);
+    if (wd < 0) return;
+
+    if ((uint32_t) wd >= watcher -> dir_capacity) {
+        uint32_t capacity = watcher -> dir_capacity * 2;
+        while (capacity <= (uint32_t) wd) capacity *= 2;
+
+        watcher -> dirs = grow(watcher -> arena, watcher -> dirs, sizeof(char*) * watcher -> dir_capacity, sizeof(char*) * capacity);
+        watcher -> dir_capacity = capacity;
+    }
+
+    if (watcher -> dirs[wd] != NULL) return;
+
+    char* copy = arena_alloc(watcher -> arena, len + 1);
+    memcpy(copy, dir, len);
+    copy[len] = 0;
+
+    watcher -> dirs[wd] = copy;
+    watcher -> dir_count++;
+}
+
+// Only events on inputs start a build, the build's own outputs (objects and libraries linked
+// into other targets) change every time it runs
+static void add_input(Watcher* watcher, uint32_t id) {
+    if (watcher -> db.entries[id].record != NULL) return;
+
+    if (id >= watcher -> input_capacity) {
+        uint32_t capacity = watcher -> input_capacity * 2;
+        while (capacity <= id) capacity *= 2;
+
+        watcher -> inputs = grow(watcher -> arena, watcher -> inputs, watcher -> input_capacity, capacity);
+        watcher -> input_capacity = capacity;
+    }
+
+    if (watcher -> inputs[id]) return;
+    watcher -> inputs[id] = true;
+
+    // System headers are not watched
+    const char* key = database_path(&watcher -> db, id);
+    if (key[0] == '/') return;
+
+    const char* slash = strrchr(key, '/');
+    watch_dir(watcher, key, slash != NULL ? (size_t) (slash - key) : 0);
+}
+
+// Every build may add inputs, a source that now includes a new header for one
+static void add_recorded_inputs(Watcher* watcher) {
+    const BuildDatabase* db = &watcher -> db;
+
+    for (uint32_t id = 0; id < db -> entry_count; id++) {
+        const DatabaseRecord* record = db -> entries[id].record;
+        if (record == NULL) continue;
+
+        for (uint32_t i = 0; i < record -> input_count; i++) {
+            add_input(watcher, record -> inputs[i]);
+        }
+    }
+}
+
+// Sources that never compiled have no record naming them yet
+static void add_inputs(Watcher* watcher) {
+    const CatalyzeConfig* config = watcher -> config;
+
+    for (uint8_t t = 0; t < config -> target_count; t++) {
+        const Target* target = &config -> targets[t];
+
+        for (uint8_t i = 0; i < target -> source_count; i++) {
+            char path[PATH_MAX];
+            snprintf(path, sizeof(path), "%s%s", target -> sources[i][0] != '/' ? config -> prefix : "", target -> sources[i]);
+
+            add_input(watcher, database_intern(&watcher -> db, path));
+        }
+    }
+
+    add_recorded_inputs(watcher);
+}
+
+static void open_watcher(Watcher* watcher, ArenaAllocator* arena, const CatalyzeConfig* config) {
+    watcher -> arena = arena;
+    watcher -> config = config;
+    watcher -> dir_capacity = 64;
+    watcher -> dirs = grow(arena, NULL, 0, sizeof(char*) * watcher -> dir_capacity);
+    watcher -> dir_count = 0;
+    watcher -> input_capacity = 256;
+    watcher -> inputs = grow(arena, NULL, 0, watcher -> input_capacity);
+    watcher -> fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+
+    if (UNLIKELY(watcher -> fd < 0)) {
+        watch_err("Failed to create inotify instance");
+    }
+
+    build_open_database(arena, config, &watcher -> db);
+
+    // The root, for config.cat
+    watch_dir(watcher, "", 0);
+    add_inputs(watcher);
+}
+
+static void close_watcher(Watcher* watcher) {
+    database_close(&watcher -> db);
+    close(watcher -> fd);
+}
+
+// The lexer exits on errors, so a changed config.cat is parsed in a child first. A broken one
+// keeps the current setup watching until the file is fixed.
+static bool config_parses(ConfigLoader load) {
+    fflush(stdout);
+
+    const pid_t pid = fork();
+    if (pid == 0) {
+        ArenaAllocator arena = {0};
+        init_arena(&arena, 0);
+
+        load(&arena);
+        _exit(0);
+    }
+
+    int status = 0;
+    if (pid < 0 || waitpid(pid, &status, 0) != pid) return false;
+
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+// Forgets the stat of every input that changed, true when any did. 'reload' is set when events
+// were lost or a directory went away, 'config_changed' when config.cat was written.
+static bool read_events(Watcher* watcher, bool* reload, bool* config_changed) {
+    char buffer[16384] __attribute__((aligned(__alignof__(struct inotify_event))));
+    bool changed = false;
+
+    while (true) {
+        const ssize_t n = read(watcher -> fd, buffer, sizeof(buffer));
+        if (n <= 0) break;
+
+        for (char* p = buffer; p < buffer + n; ) {
+            const struct inotify_event* event = (const struct inotify_event*) p;
+            p += sizeof(struct inotify_event) + event -> len;
+
+            if (UNLIKELY(event -> mask & IN_Q_OVERFLOW)) {
+                printf("\n\033[1mReloading:\033[0m too many changes at once\n");
+                *reload = true;
+                continue;
+            }
+
+            if (event -> wd < 0 || (uint32_t) event -> wd >= watcher -> dir_capacity) continue;
+
+            const char* dir = watcher -> dirs[event -> wd];
+
+            // Removed, its inputs and the directory itself may come back, so start over
+            if (event -> mask & IN_IGNORED) {
+                if (dir != NULL) {
+                    printf("\n\033[1mReloading:\033[0m a watched directory was removed\n");
+                    watcher -> dirs[event -> wd] = NULL;
+                    *reload = true;
+                }
+
+                continue;
+            }
+
+            // A new directory holds no input yet, the compile that first includes from it adds it
+            if (dir == NULL || event -> len == 0 || (event -> mask & IN_ISDIR)) continue;
+
+            if (dir[0] == 0 && strcmp(event -> name, "config.cat") == 0) {
+                *config_changed = true;
+                continue;
+            }
+
+            char path[PATH_MAX];
+            snprintf(path, sizeof(path), "%s%s%s%s", watcher -> config -> prefix, dir, dir[0] != 0 ? "/" : "", event -> name);
+
+            const uint32_t id = database_lookup(&watcher -> db, path);
+
+            if (id < watcher -> input_capacity && watcher -> inputs[id]) {
+                database_forget(&watcher -> db, id);
+                changed = true;
+            }
+        }
+    }
+
+    return changed;
+}
+
+// Blocks until an input changed and the tree has then been quiet for WATCH_QUIET_MS. True when
+// everything has to be set up again.
+static bool wait_for_changes(Watcher* watcher, Whisker_Loop* loop, const int* signal_fd, ConfigLoader load) {
+    bool changed = false;
+    bool reload = false;
+    bool config_changed = false;
+
+    while (true) {
+        Whisker_Event events[2];
+        const size_t count = loop_wait(loop, events, 2, changed || reload || config_changed ? WATCH_QUIET_MS : -1);
+
+        if (count == 0) {
+            if (!reload && config_changed) {
+                reload = config_parses(load);
+
+                if (reload) {
+                    printf("\n\033[1mReloading:\033[0m config.cat changed\n");
+                } else {
+                    printf("\033[1mWatching:\033[0m config.cat has errors, still building with the previous one\n");
+                    fflush(stdout);
+                }
+
+                config_changed = false;
+            }
+
+            if (reload || changed) return reload;
+            continue;
+        }
+
+        for (size_t e = 0; e < count; e++) {
+            if (events[e].data == signal_fd) {
+                struct signalfd_siginfo info;
+                if (read(*signal_fd, &info, sizeof(info)) != sizeof(info)) continue;
+
+                close_watcher(watcher);
+                printf("\n");
+                exit(0);
+            }
+
+            changed |= read_events(watcher, &reload, &config_changed);
+        }
+    }
+}
+
+// The build directory is only locked while building, so other commands can run in between. False
+// when one of them changed the database meanwhile, then everything is set up again.
+static bool rebuild(Watcher* watcher, ArenaAllocator* scratch, const char* target) {
+    if (!database_lock(&watcher -> db, scratch)) {
+        printf("\n\033[1mReloading:\033[0m the build database changed\n");
+        return false;
+    }
+
+    Timer timer;
+    timer_start(&timer);
+
+    const bool succeeded = build_project_watched(scratch, watcher -> config, &watcher -> db, target);
+
+    timer_end(&timer);
+
+    // A compaction gave every path a new id, the directories watched stay the same
+    if (database_unlock(&watcher -> db)) {
+        memset(watcher -> inputs, 0, watcher -> input_capacity);
+        add_inputs(watcher);
+    } else {
+        add_recorded_inputs(watcher);
+    }
+
+    arena_reset(scratch);
+
+    if (succeeded) {
+        printf("\nCompiling \033[1mfinished\033[0m! Built all targets. Took %.3f seconds\n", timer_elapsed_seconds(&timer));
+    }
+
+    printf("\033[1mWatching:\033[0m %u director%s for changes, Ctrl-C to stop\n", watcher -> dir_count, watcher -> dir_count == 1 ? "y" : "ies");
+    fflush(stdout);
+
+    return true;
+}
+
+void watch_project(ConfigLoader load, const char* target) {
+    // Stays blocked for good, the scheduler reads the same signals through its own signalfd
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    sigprocmask(SIG_BLOCK, &signals, NULL);
+
+    int signal_fd = signalfd(-1, &signals, SFD_NONBLOCK | SFD_CLOEXEC);
+
+    Whisker_Loop loop;
+    if (UNLIKELY(signal_fd < 0 || !loop_init(&loop) || !loop_add_fd(&loop, signal_fd, &signal_fd))) {
+        watch_err("Failed to watch for signals");
+    }
+
+    // Config, database and watches live as long as one config.cat, a plan as long as one build
+    ArenaAllocator session = {0};
+    ArenaAllocator scratch = {0};
+    init_arena(&session, 0);
+    init_arena(&scratch, 0);
+
+    while (true) {
+        Watcher watcher;
+        open_watcher(&watcher, &session, load(&session));
+
+        if (UNLIKELY(!loop_add_fd(&loop, watcher.fd, &watcher))) {
+            watch_err("Failed to watch for changes");
+        }
+
+        do {
+            if (!rebuild(&watcher, &scratch, target)) break;
+        } while (!wait_for_changes(&watcher, &loop, &signal_fd, load));
+
+        loop_remove_fd(&loop, watcher.fd);
+        close_watcher(&watcher);
+        arena_reset(&session);
+    }
+}
@@ -0,0 +1,25 @@
+#ifndef WATCH_H
+#define WATCH_H
+
+#include "../config/config.h"
+#include "../utils/arena.h"
+
+/*
+ *  catalyze watch, continuous rebuilds
+ *
+ *  config.cat is parsed and the build database opened once. Every source, every header a
+ *  depfile listed and config.cat itself are watched through inotify on their directories. A
+ *  burst of events is collected until the tree has been quiet for a moment, then only the
+ *  paths that changed are stat'ed again and the build is planned from the cached stats of
+ *  everything else. Edits to config.cat start over from a fresh parse. The database is only
+ *  locked while building and is compacted once a build ends, keeping the cached stats. Another
+ *  catalyze command that writes to it in between makes watch start over. A build's own memory
+ *  is let go when it ends, so a long session does not grow.
+ */
+
+// Parses config.cat into 'arena', so a reload can hand back the memory of the previous one
+typedef CatalyzeConfig* (*ConfigLoader)(ArenaAllocator* arena);
+
+void watch_project(ConfigLoader load, const char* target);
+
+#endif // !WATCH_H
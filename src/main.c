@@ -7,10 +7,12 @@
 #include "config/config.h"
 
 #include "core/build.h"
+#include "core/cache.h"
 #include "core/debug.h"
 #include "core/init.h"
 #include "core/new.h"
 #include "core/run.h"
+#include "core/watch.h"
 
 #include "utils/arena.h"
 #include "utils/help.h"
@@ -18,6 +20,9 @@
 #include "utils/timer.h"
 
 static ArenaAllocator arena = {0};
+static uint16_t jobs_override = 0;
+static bool keep_going = false;
+static bool adaptive = false;
 
 static void print_err(const char* msg) {
     fprintf(stderr, "\033[1mError:\033[0m %s\n", msg);
@@ -29,36 +34,95 @@ typedef struct {
     int (*handler)(int argc, char* argv[]);
     uint8_t min_args;
     uint8_t max_args;
+    bool build_options;
 } Command;
 
 static int handle_build(int argc, char* argv[]);
+static int handle_cache(int argc, char* argv[]);
 static int handle_debug(int argc, char* argv[]);
 static int handle_init(int argc, char* argv[]);
 static int handle_new(int argc, char* argv[]);
 static int handle_run(int argc, char* argv[]);
 static int handle_test(int argc, char* argv[]);
+static int handle_watch(int argc, char* argv[]);
 
 static const Command commands[] = {
-    {"build", handle_build, 2, 18},
-    {"debug", handle_debug, 2, 18}, 
-    {"init",  handle_init,  2, 2 },
-    {"new",   handle_new,   3, 3 },
-    {"run",   handle_run,   2, 3 },
-    {"test",  handle_test,  2, 3 },
-    {NULL,    NULL,         0, 0 } 
+    {"build", handle_build, 2, 18, true },
+    {"cache", handle_cache, 2, 3,  false},
+    {"debug", handle_debug, 2, 18, true },
+    {"init",  handle_init,  2, 2,  false},
+    {"new",   handle_new,   3, 3,  false},
+    {"run",   handle_run,   2, 3,  true },
+    {"test",  handle_test,  2, 3,  true },
+    {"watch", handle_watch, 2, 3,  true },
+    {NULL,    NULL,         0, 0,  false}
 };
 
+static uint16_t parse_job_count(const char* value) {
+    char* end = NULL;
+    unsigned long jobs = strtoul(value, &end, 10);
+
+    if (UNLIKELY(end == value || *end != 0 || jobs == 0 || jobs > MAX_JOBS)) {
+        print_err("Job count must be between 1 and 1024");
+    }
+
+    return (uint16_t) jobs;
+}
+
+// Strips build options out of argv so handlers only ever see target names
+static int parse_build_options(int argc, char* argv[]) {
+    int count = 2;
+
+    for (int i = 2; i < argc; i++) {
+        const char* arg = argv[i];
+
+        if (strcmp(arg, "-j") == 0 || strcmp(arg, "--jobs") == 0) {
+            if (UNLIKELY(i + 1 >= argc)) {
+                print_err("Expected a job count after -j");
+            }
+
+            jobs_override = parse_job_count(argv[++i]);
+        } else if (strcmp(arg, "-k") == 0 || strcmp(arg, "--keep-going") == 0) {
+            keep_going = true;
+        } else if (strcmp(arg, "--adaptive") == 0) {
+            adaptive = true;
+        } else if (strncmp(arg, "-j", 2) == 0) {
+            jobs_override = parse_job_count(arg + 2);
+        } else {
+            argv[count++] = argv[i];
+        }
+    }
+
+    argv[count] = NULL;
+    return count;
+}
+
+static CatalyzeConfig* load_config_into(ArenaAllocator* config_arena) {
+    CatalyzeConfig* config = parse_config(config_arena);
+
+    if (jobs_override != 0) {
+        config -> jobs = jobs_override;
+    }
+
+    config -> keep_going = keep_going;
+    config -> adaptive |= adaptive;
+
+    return config;
+}
+
+static CatalyzeConfig* load_config(void) {
+    return load_config_into(&arena);
+}
+
 static int handle_build(int argc, char* argv[]) {
-    CatalyzeConfig* config = parse_config(&arena);
+    CatalyzeConfig* config = load_config();
     Timer timer;
     timer_start(&timer);
 
     if (argc == 2) {
         build_project_all(&arena, config);
     } else {
-        for (uint8_t i = 2; i < argc; i++) {
-            build_project_target(&arena, config, argv[i]);
-        }
+        build_project_targets(&arena, config, (const char* const*) argv + 2, (uint8_t) (argc - 2));
     }
 
     timer_end(&timer);
@@ -67,17 +131,30 @@ static int handle_build(int argc, char* argv[]) {
     return 0;
 }
 
+static int handle_cache(int argc, char* argv[]) {
+    if (argc == 3) {
+        if (strcmp(argv[2], "clear") != 0) {
+            print_err("Unknown cache command, expected 'clear'");
+        }
+
+        cache_clear(&arena);
+        printf("Cache cleared\n");
+        return 0;
+    }
+
+    cache_print_stats(&arena);
+    return 0;
+}
+
 static int handle_debug(int argc, char* argv[]) {
-    CatalyzeConfig* config = parse_config(&arena);
+    CatalyzeConfig* config = load_config();
     Timer timer;
     timer_start(&timer);
 
     if (argc == 2) {
         debug_all(&arena, config);
     } else {
-        for (uint8_t i = 2; i < argc; i++) {
-            debug_target(&arena, config, argv[i]);
-        }
+        debug_targets(&arena, config, (const char* const*) argv + 2, (uint8_t) (argc - 2));
     }
 
     timer_end(&timer);
@@ -108,7 +185,7 @@ static int handle_new(int argc, char* argv[]) {
 }
 
 static int handle_run(int argc, char* argv[]) {
-    CatalyzeConfig* config = parse_config(&arena);
+    CatalyzeConfig* config = load_config();
     if (argc == 2) {
         run_project_all(&arena, config);
     } else {
@@ -121,7 +198,7 @@ static int handle_run(int argc, char* argv[]) {
 static int handle_test(int argc, char* argv[]) {
     // TODO: Testing lol
     
-    CatalyzeConfig* config = parse_config(&arena);
+    CatalyzeConfig* config = load_config();
     print_catalyze_config(config);
     // if (argc == 2) {
     //     run_project_all(&arena, config);
@@ -132,6 +209,11 @@ static int handle_test(int argc, char* argv[]) {
     return 0;
 }
 
+static int handle_watch(int argc, char* argv[]) {
+    watch_project(load_config_into, argc == 3 ? argv[2] : NULL);
+    return 0;
+}
+
 static const Command* find_command(const char* name) {
     for (const Command* cmd = commands; cmd -> name != NULL; cmd++) {
         if (strcmp(cmd -> name, name) == 0) {
@@ -154,6 +236,10 @@ int main(int argc, char* argv[]) {
         exit(1);
     }
 
+    if (cmd -> build_options) {
+        argc = parse_build_options(argc, argv);
+    }
+
     if (argc < cmd -> min_args || argc > cmd -> max_args) {
         print_err("Invalid number of arguments");
         exit(1);
@@ -0,0 +1,27 @@
+#ifndef HASH_H
+#define HASH_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#define HASH_SEED 0xcbf29ce484222325ull
+
+// FNV-1a, 64 bit. Chain calls by passing the previous result as the seed.
+static inline uint64_t hash_bytes(uint64_t hash, const void* data, size_t len) {
+    const unsigned char* bytes = data;
+
+    for (size_t i = 0; i < len; i++) {
+        hash ^= bytes[i];
+        hash *= 0x100000001b3ull;
+    }
+
+    return hash;
+}
+
+// The terminator is hashed too, so {"ab", "c"} and {"a", "bc"} differ
+static inline uint64_t hash_string(uint64_t hash, const char* s) {
+    return hash_bytes(hash, s, strlen(s) + 1);
+}
+
+#endif // !HASH_H
@@ -33,6 +33,16 @@ static void print_help(void) {
     printf("        Builds the specified target\n");
     printf("        If no target is specified, builds all targets\n\n");
     
+    // watch command
+    printf("    " BOLD GREEN "watch" RESET " " YELLOW "[target]" RESET "\n");
+    printf("        Builds the specified target, or all targets, and rebuilds whenever\n");
+    printf("        a source, header or config.cat changes\n\n");
+    
+    // cache command
+    printf("    " BOLD GREEN "cache" RESET " " YELLOW "[clear]" RESET "\n");
+    printf("        Shows hits, misses and size of the object cache\n");
+    printf("        With 'clear', removes every cached object\n\n");
+    
     // run command
     printf("    " BOLD GREEN "run" RESET " " YELLOW "[target]" RESET "\n");
     printf("        Runs the specified executable target\n");
@@ -52,11 +62,24 @@ static void print_help(void) {
     printf("    " BOLD GREEN "help" RESET "\n");
     printf("        Display this help message\n\n");
     
+    printf(BOLD "OPTIONS:" RESET "\n");
+    printf("    " BOLD GREEN "-j, --jobs" RESET " " YELLOW "<count>" RESET "\n");
+    printf("        Number of compile jobs to run in parallel (build, run, test, debug, watch)\n");
+    printf("        Defaults to the 'jobs' config key, then to the CPUs available to catalyze\n\n");
+    printf("    " BOLD GREEN "-k, --keep-going" RESET "\n");
+    printf("        Keep building everything that does not depend on a failed job,\n");
+    printf("        then list all failures and exit with a nonzero status\n\n");
+    printf("    " BOLD GREEN "--adaptive" RESET "\n");
+    printf("        Adjust the number of running jobs between 'min_jobs' and the job count\n");
+    printf("        based on CPU and memory pressure (PSI) and the load average\n\n");
+
     printf(BOLD "EXAMPLES:" RESET "\n");
     printf("    " BOLD "catalyze new" RESET " myproject      " BLUE "# Create new project called 'myproject'" RESET "\n");
     printf("    " BOLD "catalyze init" RESET "               " BLUE "# Initialize project in current directory" RESET "\n");
     printf("    " BOLD "catalyze build" RESET "              " BLUE "# Build all targets" RESET "\n");
     printf("    " BOLD "catalyze build" RESET " release      " BLUE "# Build only the 'release' target" RESET "\n");
+    printf("    " BOLD "catalyze build" RESET " -j 4         " BLUE "# Build all targets with 4 parallel jobs" RESET "\n");
+    printf("    " BOLD "catalyze watch" RESET "              " BLUE "# Rebuild all targets on every change" RESET "\n");
     printf("    " BOLD "catalyze run" RESET " myapp          " BLUE "# Run the 'myapp' executable" RESET "\n");
     printf("    " BOLD "catalyze test" RESET "               " BLUE "# Run all tests" RESET "\n");
     printf("    " BOLD "catalyze debug" RESET " myapp        " BLUE "# Build and run 'myapp' in debug mode" RESET "\n\n");
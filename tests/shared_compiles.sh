@@ -0,0 +1,88 @@
+#!/usr/bin/env bash
+
+# An executable, a test and a debug target built from the same sources with the same flags
+# must compile each source once, in a single build whose links run side by side:
+# ./tests/shared_compiles.sh [path to catalyze]
+
+CATALYZE=$(realpath "${1:-build/bin/catalyze}")
+PROJECT=$(mktemp -d)
+trap 'rm -rf "$PROJECT"' EXIT
+
+cd "$PROJECT" || exit 1
+mkdir src
+
+# Logs every compile, and holds every link long enough to see whether the links overlap
+cat > cc.sh <<'CC'
+#!/usr/bin/env bash
+if [ "$1" = "-c" ]; then
+    echo "$2" >> compiles.log
+    exec gcc "$@"
+fi
+
+echo start >> links.log
+sleep 0.5
+gcc "$@"
+status=$?
+echo end >> links.log
+exit $status
+CC
+chmod +x cc.sh
+
+printf 'int add(int a, int b) { return a + b; }\n' > src/add.c
+printf 'int add(int a, int b);\nint main(void) { return add(1, -1); }\n' > src/main.c
+
+cat > config.cat <<'CONFIG'
+config {
+    compiler: ./cc.sh
+    build_dir: build/
+    default_flags: [-Wall]
+}
+
+target executable app {
+    sources: [src/main.c src/add.c]
+    flags: [-O1]
+    output: build/bin/app
+}
+
+target test app_tests {
+    sources: [src/main.c src/add.c]
+    flags: [-O1]
+    output: build/test/app_tests
+}
+
+target debug app_debug {
+    sources: [src/main.c src/add.c]
+    flags: [-O1]
+    output: build/debug/app_debug
+}
+CONFIG
+
+if ! "$CATALYZE" build -j 4 app app_tests app_debug > build.log 2>&1; then
+    cat build.log
+    echo "FAIL: build failed"
+    exit 1
+fi
+
+for target in build/bin/app build/test/app_tests build/debug/app_debug; do
+    if [ ! -x "$target" ]; then
+        echo "FAIL: $target was not linked"
+        exit 1
+    fi
+done
+
+for source in src/main.c src/add.c; do
+    count=$(grep -c "$source\$" compiles.log)
+
+    if [ "$count" != 1 ]; then
+        echo "FAIL: $source compiled $count times"
+        exit 1
+    fi
+done
+
+# Targets built one after another would alternate start, end, start, end
+if [ "$(head -n 2 links.log | tr '\n' ' ')" != "start start " ]; then
+    echo "FAIL: the links did not run in one build"
+    exit 1
+fi
+
+echo "PASS"
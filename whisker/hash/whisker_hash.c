@@ -0,0 +1,168 @@
+#include "whisker_hash.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define UNLIKELY(x) __builtin_expect(x, 0)
+#define LIKELY(x) __builtin_expect(x, 1)
+
+#define WHISKER_STRIPE 64
+#define WHISKER_BLOCK_STRIPES 16
+#define WHISKER_SCRAMBLE_KEY 24
+#define WHISKER_MERGE_KEY 8
+#define WHISKER_READ_LIMIT 16384
+
+#define WHISKER_PRIME32_1 0x9e3779b1ull
+#define WHISKER_PRIME32_2 0x85ebca77ull
+#define WHISKER_PRIME32_3 0xc2b2ae3dull
+#define WHISKER_PRIME64_1 0x9e3779b185ebca87ull
+#define WHISKER_PRIME64_2 0xc2b2ae3d27d4eb4full
+#define WHISKER_PRIME64_3 0x165667b19e3779f9ull
+#define WHISKER_PRIME64_4 0x85ebca77c2b2ae63ull
+#define WHISKER_PRIME64_5 0x27d4eb2f165667c5ull
+
+// Stripe k of a block keys lane i with word k + i, the scramble uses words 24 to 31
+const uint64_t whisker_hash_secret[32] = {
+    0xe220a8397b1dcdafull, 0x6e789e6aa1b965f4ull, 0x06c45d188009454full, 0xf88bb8a8724c81ecull,
+    0x1b39896a51a8749bull, 0x53cb9f0c747ea2eaull, 0x2c829abe1f4532e1ull, 0xc584133ac916ab3cull,
+    0x3ee5789041c98ac3ull, 0xf3b8488c368cb0a6ull, 0x657eecdd3cb13d09ull, 0xc2d326e0055bdef6ull,
+    0x8621a03fe0bbdb7bull, 0x8e1f7555983aa92full, 0xb54e0f1600cc4d19ull, 0x84bb3f97971d80abull,
+    0x7d29825c75521255ull, 0xc3cf17102b7f7f86ull, 0x3466e9a083914f64ull, 0xd81a8d2b5a4485acull,
+    0xdb01602b100b9ed7ull, 0xa9038a921825f10dull, 0xedf5f1d90dca2f6aull, 0x54496ad67bd2634cull,
+    0xdd7c01d4f5407269ull, 0x935e82f1db4c4f7bull, 0x69b82ebc92233300ull, 0x40d29eb57de1d510ull,
+    0xa2f09dabb45c6316ull, 0xee521d7a0f4d3872ull, 0xf16952ee72f3454full, 0x377d35dea8e40225ull,
+};
+
+extern void whisker_hash_accumulate_avx2(uint64_t* acc, const uint8_t* data, size_t stripes, const uint64_t* secret);
+extern void whisker_hash_scramble_avx2(uint64_t* acc, const uint64_t* secret);
+
+extern void whisker_hash_accumulate_sse2(uint64_t* acc, const uint8_t* data, size_t stripes, const uint64_t* secret);
+extern void whisker_hash_scramble_sse2(uint64_t* acc, const uint64_t* secret);
+
+extern void whisker_hash_accumulate_generic(uint64_t* acc, const uint8_t* data, size_t stripes, const uint64_t* secret);
+extern void whisker_hash_scramble_generic(uint64_t* acc, const uint64_t* secret);
+
+static void (*whisker_hash_accumulate_impl)(uint64_t* acc, const uint8_t* data, size_t stripes, const uint64_t* secret);
+static void (*whisker_hash_scramble_impl)(uint64_t* acc, const uint64_t* secret);
+
+__attribute__((constructor)) static void whisker_hash_dispatch(void) {
+    __builtin_cpu_init();
+
+    if (__builtin_cpu_supports("avx2")) {
+        whisker_hash_accumulate_impl = whisker_hash_accumulate_avx2;
+        whisker_hash_scramble_impl = whisker_hash_scramble_avx2;
+    } else if (__builtin_cpu_supports("sse2")) {
+        whisker_hash_accumulate_impl = whisker_hash_accumulate_sse2;
+        whisker_hash_scramble_impl = whisker_hash_scramble_sse2;
+    } else {
+        whisker_hash_accumulate_impl = whisker_hash_accumulate_generic;
+        whisker_hash_scramble_impl = whisker_hash_scramble_generic;
+    }
+}
+
+static inline uint64_t whisker_fold64(uint64_t a, uint64_t b) {
+    const __uint128_t product = (__uint128_t) a * b;
+    return (uint64_t) product ^ (uint64_t) (product >> 64);
+}
+
+static inline uint64_t whisker_avalanche(uint64_t hash) {
+    hash ^= hash >> 37;
+    hash *= 0x165667919e3779f9ull;
+    hash ^= hash >> 32;
+    return hash;
+}
+
+uint64_t whisker_hash64(const void* data, size_t len, uint64_t seed) {
+    uint64_t acc[8] __attribute__((aligned(32))) = {
+        WHISKER_PRIME32_3 + seed, WHISKER_PRIME64_1 + seed, WHISKER_PRIME64_2 + seed, WHISKER_PRIME64_3 + seed,
+        WHISKER_PRIME64_4 + seed, WHISKER_PRIME32_2 + seed, WHISKER_PRIME64_5 + seed, WHISKER_PRIME32_1 + seed,
+    };
+
+    const uint8_t* bytes = data;
+    size_t stripes = len / WHISKER_STRIPE;
+    size_t position = 0;
+
+    while (stripes > 0) {
+        const size_t count = stripes < WHISKER_BLOCK_STRIPES - position ? stripes : WHISKER_BLOCK_STRIPES - position;
+
+        whisker_hash_accumulate_impl(acc, bytes, count, whisker_hash_secret + position);
+        bytes += count * WHISKER_STRIPE;
+        stripes -= count;
+        position += count;
+
+        if (position == WHISKER_BLOCK_STRIPES) {
+            whisker_hash_scramble_impl(acc, whisker_hash_secret + WHISKER_SCRAMBLE_KEY);
+            position = 0;
+        }
+    }
+
+    const size_t rest = len % WHISKER_STRIPE;
+
+    if (rest != 0) {
+        uint8_t last[WHISKER_STRIPE] __attribute__((aligned(32))) = {0};
+        memcpy(last, bytes, rest);
+
+        whisker_hash_accumulate_impl(acc, last, 1, whisker_hash_secret + position);
+    }
+
+    uint64_t hash = (uint64_t) len * WHISKER_PRIME64_1 ^ seed;
+
+    for (size_t i = 0; i < 4; i++) {
+        hash += whisker_fold64(acc[2 * i] ^ whisker_hash_secret[WHISKER_MERGE_KEY + 2 * i], acc[2 * i + 1] ^ whisker_hash_secret[WHISKER_MERGE_KEY + 2 * i + 1]);
+    }
+
+    return whisker_avalanche(hash);
+}
+
+bool whisker_hash_file(const char* path, uint64_t seed, uint64_t* hash) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (UNLIKELY(fd < 0)) return false;
+
+    struct stat st;
+    if (UNLIKELY(fstat(fd, &st) != 0)) {
+        close(fd);
+        return false;
+    }
+
+    const size_t size = (size_t) st.st_size;
+
+    // Sources and headers are mostly small, a read is cheaper than setting up a mapping
+    if (LIKELY(size <= WHISKER_READ_LIMIT)) {
+        uint8_t buffer[WHISKER_READ_LIMIT];
+        size_t filled = 0;
+
+        while (filled < size) {
+            const ssize_t n = read(fd, buffer + filled, size - filled);
+
+            if (n < 0) {
+                if (errno == EINTR) continue;
+
+                close(fd);
+                return false;
+            }
+
+            if (n == 0) break;
+            filled += (size_t) n;
+        }
+
+        close(fd);
+        *hash = whisker_hash64(buffer, filled, seed);
+        return true;
+    }
+
+    void* map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if (UNLIKELY(map == MAP_FAILED)) return false;
+
+    madvise(map, size, MADV_SEQUENTIAL);
+    *hash = whisker_hash64(map, size, seed);
+    munmap(map, size);
+
+    return true;
+}
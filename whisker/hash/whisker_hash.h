@@ -0,0 +1,30 @@
+#ifndef WHISKER_HASH_H
+#define WHISKER_HASH_H
+
+#ifdef WHISKER_NOPREFIX
+    #define hash64 whisker_hash64
+    #define hash_file whisker_hash_file
+#endif
+
+/*
+ *  Non-cryptographic 64 bit content hash
+ *
+ *      Input is consumed in 64 byte stripes by eight 64 bit accumulators, every lane mixes a
+ *      32x32 bit product of its input and a secret word and hands the raw input to its
+ *      neighbour. Every 16 stripes the accumulators are scrambled, the partial last stripe is
+ *      zero padded and the length is folded into the final avalanche.
+ *
+ *      The stripe kernel is picked at startup (AVX2, SSE2 or plain C). All kernels compute
+ *      exactly the same lanes, so a hash never depends on the machine that produced it.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+uint64_t whisker_hash64(const void* data, size_t len, uint64_t seed);
+
+// Hashes a whole file, small files are read and larger ones mapped. False when it cannot be read.
+bool whisker_hash_file(const char* path, uint64_t seed, uint64_t* hash);
+
+#endif // !WHISKER_HASH_H
@@ -0,0 +1,52 @@
+#include "whisker_hash.h"
+
+#include <immintrin.h>
+#include <stdint.h>
+
+#define WHISKER_PRIME32_1 0x9e3779b1u
+
+void whisker_hash_accumulate_avx2(uint64_t* acc, const uint8_t* data, size_t stripes, const uint64_t* secret) {
+    __m256i acc0 = _mm256_loadu_si256((const __m256i*) acc);
+    __m256i acc1 = _mm256_loadu_si256((const __m256i*) (acc + 4));
+
+    for (size_t s = 0; s < stripes; s++) {
+        const uint8_t* stripe = data + s * 64;
+
+        const __m256i value0 = _mm256_loadu_si256((const __m256i*) stripe);
+        const __m256i value1 = _mm256_loadu_si256((const __m256i*) (stripe + 32));
+        const __m256i keyed0 = _mm256_xor_si256(value0, _mm256_loadu_si256((const __m256i*) (secret + s)));
+        const __m256i keyed1 = _mm256_xor_si256(value1, _mm256_loadu_si256((const __m256i*) (secret + s + 4)));
+
+        // Low half of every lane times its high half, as a full 64 bit product
+        const __m256i product0 = _mm256_mul_epu32(keyed0, _mm256_srli_epi64(keyed0, 32));
+        const __m256i product1 = _mm256_mul_epu32(keyed1, _mm256_srli_epi64(keyed1, 32));
+
+        // Neighbouring lanes swap their raw input
+        acc0 = _mm256_add_epi64(acc0, _mm256_add_epi64(product0, _mm256_shuffle_epi32(value0, _MM_SHUFFLE(1, 0, 3, 2))));
+        acc1 = _mm256_add_epi64(acc1, _mm256_add_epi64(product1, _mm256_shuffle_epi32(value1, _MM_SHUFFLE(1, 0, 3, 2))));
+    }
+
+    _mm256_storeu_si256((__m256i*) acc, acc0);
+    _mm256_storeu_si256((__m256i*) (acc + 4), acc1);
+}
+
+static inline __m256i whisker_scramble_lanes(__m256i value, __m256i key) {
+    const __m256i prime = _mm256_set1_epi32((int) WHISKER_PRIME32_1);
+
+    value = _mm256_xor_si256(value, _mm256_srli_epi64(value, 47));
+    value = _mm256_xor_si256(value, key);
+
+    // 64 x 32 bit multiply, built from the two 32 x 32 bit halves
+    const __m256i low = _mm256_mul_epu32(value, prime);
+    const __m256i high = _mm256_mul_epu32(_mm256_srli_epi64(value, 32), prime);
+
+    return _mm256_add_epi64(low, _mm256_slli_epi64(high, 32));
+}
+
+void whisker_hash_scramble_avx2(uint64_t* acc, const uint64_t* secret) {
+    const __m256i acc0 = _mm256_loadu_si256((const __m256i*) acc);
+    const __m256i acc1 = _mm256_loadu_si256((const __m256i*) (acc + 4));
+
+    _mm256_storeu_si256((__m256i*) acc, whisker_scramble_lanes(acc0, _mm256_loadu_si256((const __m256i*) secret)));
+    _mm256_storeu_si256((__m256i*) (acc + 4), whisker_scramble_lanes(acc1, _mm256_loadu_si256((const __m256i*) (secret + 4))));
+}
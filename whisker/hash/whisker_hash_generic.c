@@ -0,0 +1,42 @@
+#include "whisker_hash.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#define WHISKER_PRIME32_1 0x9e3779b1ull
+
+// Lanes are little endian words, so the hash of a file is the same on every machine
+static inline uint64_t whisker_read64(const uint8_t* p) {
+    uint64_t value;
+    memcpy(&value, p, sizeof(value));
+
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    value = __builtin_bswap64(value);
+#endif
+
+    return value;
+}
+
+void whisker_hash_accumulate_generic(uint64_t* acc, const uint8_t* data, size_t stripes, const uint64_t* secret) {
+    for (size_t s = 0; s < stripes; s++) {
+        const uint8_t* stripe = data + s * 64;
+
+        for (size_t i = 0; i < 8; i++) {
+            const uint64_t value = whisker_read64(stripe + i * 8);
+            const uint64_t keyed = value ^ secret[s + i];
+
+            acc[i ^ 1] += value;
+            acc[i] += (keyed & 0xffffffffull) * (keyed >> 32);
+        }
+    }
+}
+
+void whisker_hash_scramble_generic(uint64_t* acc, const uint64_t* secret) {
+    for (size_t i = 0; i < 8; i++) {
+        uint64_t value = acc[i];
+
+        value ^= value >> 47;
+        value ^= secret[i];
+        acc[i] = value * WHISKER_PRIME32_1;
+    }
+}
@@ -0,0 +1,50 @@
+#include "whisker_hash.h"
+
+#include <immintrin.h>
+#include <stdint.h>
+
+#define WHISKER_PRIME32_1 0x9e3779b1u
+
+void whisker_hash_accumulate_sse2(uint64_t* acc, const uint8_t* data, size_t stripes, const uint64_t* secret) {
+    __m128i lanes[4];
+
+    for (size_t j = 0; j < 4; j++) {
+        lanes[j] = _mm_loadu_si128((const __m128i*) (acc + 2 * j));
+    }
+
+    for (size_t s = 0; s < stripes; s++) {
+        const uint8_t* stripe = data + s * 64;
+
+        for (size_t j = 0; j < 4; j++) {
+            const __m128i value = _mm_loadu_si128((const __m128i*) (stripe + 16 * j));
+            const __m128i keyed = _mm_xor_si128(value, _mm_loadu_si128((const __m128i*) (secret + s + 2 * j)));
+
+            // Low half of every lane times its high half, as a full 64 bit product
+            const __m128i product = _mm_mul_epu32(keyed, _mm_srli_epi64(keyed, 32));
+
+            // Neighbouring lanes swap their raw input
+            lanes[j] = _mm_add_epi64(lanes[j], _mm_add_epi64(product, _mm_shuffle_epi32(value, _MM_SHUFFLE(1, 0, 3, 2))));
+        }
+    }
+
+    for (size_t j = 0; j < 4; j++) {
+        _mm_storeu_si128((__m128i*) (acc + 2 * j), lanes[j]);
+    }
+}
+
+void whisker_hash_scramble_sse2(uint64_t* acc, const uint64_t* secret) {
+    const __m128i prime = _mm_set1_epi32((int) WHISKER_PRIME32_1);
+
+    for (size_t j = 0; j < 4; j++) {
+        __m128i value = _mm_loadu_si128((const __m128i*) (acc + 2 * j));
+
+        value = _mm_xor_si128(value, _mm_srli_epi64(value, 47));
+        value = _mm_xor_si128(value, _mm_loadu_si128((const __m128i*) (secret + 2 * j)));
+
+        // 64 x 32 bit multiply, built from the two 32 x 32 bit halves
+        const __m128i low = _mm_mul_epu32(value, prime);
+        const __m128i high = _mm_mul_epu32(_mm_srli_epi64(value, 32), prime);
+
+        _mm_storeu_si128((__m128i*) (acc + 2 * j), _mm_add_epi64(low, _mm_slli_epi64(high, 32)));
+    }
+}
@@ -0,0 +1,271 @@
+#include "whisker_loop.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <sys/epoll.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifndef SYS_pidfd_open
+#define SYS_pidfd_open 434
+#endif
+
+#define WHISKER_POLL_INTERVAL_MS 10
+#define WHISKER_MAX_EPOLL_EVENTS 64
+
+struct Whisker_Watch {
+    Whisker_Watch* next;
+    Whisker_Watch* prev;
+    void* data;
+    uint64_t deadline_ns;
+    pid_t pid;
+    int fd;
+    bool timed_out;
+};
+
+static inline uint64_t whisker_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ull + (uint64_t) ts.tv_nsec;
+}
+
+static void whisker_watch_link(Whisker_Watch** list, Whisker_Watch* watch) {
+    watch -> prev = NULL;
+    watch -> next = *list;
+
+    if (*list) {
+        (*list) -> prev = watch;
+    }
+
+    *list = watch;
+}
+
+static void whisker_watch_unlink(Whisker_Watch** list, Whisker_Watch* watch) {
+    if (watch -> prev) {
+        watch -> prev -> next = watch -> next;
+    } else {
+        *list = watch -> next;
+    }
+
+    if (watch -> next) {
+        watch -> next -> prev = watch -> prev;
+    }
+}
+
+bool whisker_loop_init(Whisker_Loop* loop) {
+    assert(loop);
+
+    loop -> epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    loop -> children = NULL;
+    loop -> fds = NULL;
+    loop -> polled_children = 0;
+
+    return loop -> epoll_fd >= 0;
+}
+
+static void whisker_loop_free_list(Whisker_Watch* watch) {
+    while (watch) {
+        Whisker_Watch* next = watch -> next;
+
+        if (watch -> pid != 0 && watch -> fd >= 0) {
+            close(watch -> fd);
+        }
+
+        free(watch);
+        watch = next;
+    }
+}
+
+void whisker_loop_destroy(Whisker_Loop* loop) {
+    if (!loop) return;
+
+    whisker_loop_free_list(loop -> children);
+    whisker_loop_free_list(loop -> fds);
+
+    if (loop -> epoll_fd >= 0) {
+        close(loop -> epoll_fd);
+    }
+
+    loop -> children = NULL;
+    loop -> fds = NULL;
+    loop -> epoll_fd = -1;
+    loop -> polled_children = 0;
+}
+
+bool whisker_loop_add_child(Whisker_Loop* loop, pid_t pid, uint32_t timeout_ms, void* data) {
+    assert(loop && pid > 0);
+
+    Whisker_Watch* watch = calloc(1, sizeof(*watch));
+    if (!watch) {
+        return false;
+    }
+
+    watch -> pid = pid;
+    watch -> data = data;
+    watch -> deadline_ns = timeout_ms ? whisker_now_ns() + (uint64_t) timeout_ms * 1000000ull : 0;
+    watch -> fd = (int) syscall(SYS_pidfd_open, pid, 0);
+
+    if (watch -> fd >= 0) {
+        struct epoll_event event = { .events = EPOLLIN, .data.ptr = watch };
+
+        if (epoll_ctl(loop -> epoll_fd, EPOLL_CTL_ADD, watch -> fd, &event) != 0) {
+            close(watch -> fd);
+            watch -> fd = -1;
+        }
+    }
+
+    if (watch -> fd < 0) {
+        loop -> polled_children++;
+    }
+
+    whisker_watch_link(&loop -> children, watch);
+    return true;
+}
+
+bool whisker_loop_add_fd(Whisker_Loop* loop, int fd, void* data) {
+    assert(loop && fd >= 0);
+
+    Whisker_Watch* watch = calloc(1, sizeof(*watch));
+    if (!watch) {
+        return false;
+    }
+
+    watch -> fd = fd;
+    watch -> data = data;
+
+    struct epoll_event event = { .events = EPOLLIN, .data.ptr = watch };
+    if (epoll_ctl(loop -> epoll_fd, EPOLL_CTL_ADD, fd, &event) != 0) {
+        free(watch);
+        return false;
+    }
+
+    whisker_watch_link(&loop -> fds, watch);
+    return true;
+}
+
+void whisker_loop_remove_fd(Whisker_Loop* loop, int fd) {
+    for (Whisker_Watch* watch = loop -> fds; watch; watch = watch -> next) {
+        if (watch -> fd != fd) continue;
+
+        epoll_ctl(loop -> epoll_fd, EPOLL_CTL_DEL, fd, NULL);
+        whisker_watch_unlink(&loop -> fds, watch);
+        free(watch);
+        return;
+    }
+}
+
+static bool whisker_loop_reap(Whisker_Loop* loop, Whisker_Watch* watch, Whisker_Event* event) {
+    int status = 0;
+    struct rusage usage = {0};
+
+    pid_t pid = wait4(watch -> pid, &status, WNOHANG, &usage);
+    if (pid <= 0 && !(pid < 0 && errno == ECHILD)) {
+        return false;
+    }
+
+    event -> kind = WHISKER_EVENT_EXIT;
+    event -> data = watch -> data;
+    event -> fd = -1;
+    event -> status = pid > 0 ? status : 0;
+    event -> usage = usage;
+
+    if (watch -> fd >= 0) {
+        epoll_ctl(loop -> epoll_fd, EPOLL_CTL_DEL, watch -> fd, NULL);
+        close(watch -> fd);
+    } else {
+        loop -> polled_children--;
+    }
+
+    whisker_watch_unlink(&loop -> children, watch);
+    free(watch);
+
+    return true;
+}
+
+size_t whisker_loop_wait(Whisker_Loop* loop, Whisker_Event* events, size_t max_events, int timeout_ms) {
+    assert(loop && events && max_events > 0);
+
+    const uint64_t start = whisker_now_ns();
+    size_t count = 0;
+
+    while (count == 0) {
+        const uint64_t now = whisker_now_ns();
+        uint64_t nearest = 0;
+
+        for (Whisker_Watch* watch = loop -> children; watch && count < max_events; ) {
+            Whisker_Watch* next = watch -> next;
+
+            if (watch -> fd < 0 && whisker_loop_reap(loop, watch, &events[count])) {
+                count++;
+            } else if (watch -> deadline_ns != 0 && !watch -> timed_out) {
+                if (now >= watch -> deadline_ns) {
+                    watch -> timed_out = true;
+
+                    events[count].kind = WHISKER_EVENT_TIMEOUT;
+                    events[count].data = watch -> data;
+                    events[count].fd = -1;
+                    events[count].status = 0;
+                    count++;
+                } else if (nearest == 0 || watch -> deadline_ns < nearest) {
+                    nearest = watch -> deadline_ns;
+                }
+            }
+
+            watch = next;
+        }
+
+        if (count > 0) break;
+
+        int wait_ms = -1;
+        if (timeout_ms >= 0) {
+            const uint64_t elapsed_ms = (now - start) / 1000000ull;
+            if (elapsed_ms >= (uint64_t) timeout_ms) break;
+
+            wait_ms = timeout_ms - (int) elapsed_ms;
+        }
+
+        if (nearest != 0) {
+            const int deadline_ms = (int) ((nearest - now + 999999ull) / 1000000ull);
+            if (wait_ms < 0 || deadline_ms < wait_ms) {
+                wait_ms = deadline_ms;
+            }
+        }
+
+        if (loop -> polled_children > 0 && (wait_ms < 0 || wait_ms > WHISKER_POLL_INTERVAL_MS)) {
+            wait_ms = WHISKER_POLL_INTERVAL_MS;
+        }
+
+        struct epoll_event ready[WHISKER_MAX_EPOLL_EVENTS];
+        const int capacity = max_events < WHISKER_MAX_EPOLL_EVENTS ? (int) max_events : WHISKER_MAX_EPOLL_EVENTS;
+
+        int n = epoll_wait(loop -> epoll_fd, ready, capacity, wait_ms);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+
+        for (int i = 0; i < n; i++) {
+            Whisker_Watch* watch = ready[i].data.ptr;
+
+            if (watch -> pid != 0) {
+                if (whisker_loop_reap(loop, watch, &events[count])) {
+                    count++;
+                }
+
+                continue;
+            }
+
+            events[count].kind = WHISKER_EVENT_READABLE;
+            events[count].data = watch -> data;
+            events[count].fd = watch -> fd;
+            events[count].status = 0;
+            count++;
+        }
+    }
+
+    return count;
+}
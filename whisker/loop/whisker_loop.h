@@ -0,0 +1,64 @@
+#ifndef  WHISKER_LOOP_H
+#define  WHISKER_LOOP_H
+
+#ifdef WHISKER_NOPREFIX
+    #define loop_init whisker_loop_init
+    #define loop_destroy whisker_loop_destroy
+    #define loop_add_child whisker_loop_add_child
+    #define loop_add_fd whisker_loop_add_fd
+    #define loop_remove_fd whisker_loop_remove_fd
+    #define loop_wait whisker_loop_wait
+#endif
+
+/*
+ *  Event loop for supervising child processes
+ *
+ *      Children are watched through pidfds, falling back to polling wait4() on kernels
+ *      without pidfd_open(). Exited children are reaped by the loop, and their exit status
+ *      and resource usage are handed back in the event. Arbitrary fds (pipes, eventfds, ...)
+ *      can be watched alongside them.
+ *
+ *      A child may carry a timeout, a WHISKER_EVENT_TIMEOUT is reported once when it expires,
+ *      killing it is up to the caller. Its WHISKER_EVENT_EXIT still follows later.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/resource.h>
+#include <sys/types.h>
+
+typedef enum {
+    WHISKER_EVENT_EXIT,
+    WHISKER_EVENT_READABLE,
+    WHISKER_EVENT_TIMEOUT
+} Whisker_Event_Kind;
+
+typedef struct {
+    Whisker_Event_Kind kind;
+    void* data;
+    int fd;
+    int status;
+    struct rusage usage;
+} Whisker_Event;
+
+typedef struct Whisker_Watch Whisker_Watch;
+
+typedef struct {
+    int epoll_fd;
+    Whisker_Watch* children;
+    Whisker_Watch* fds;
+    size_t polled_children;
+} Whisker_Loop;
+
+bool whisker_loop_init(Whisker_Loop* loop);
+void whisker_loop_destroy(Whisker_Loop* loop);
+
+bool whisker_loop_add_child(Whisker_Loop* loop, pid_t pid, uint32_t timeout_ms, void* data);
+bool whisker_loop_add_fd(Whisker_Loop* loop, int fd, void* data);
+void whisker_loop_remove_fd(Whisker_Loop* loop, int fd);
+
+// Blocks until at least one event is ready or timeout_ms (-1 for none) has passed
+size_t whisker_loop_wait(Whisker_Loop* loop, Whisker_Event* events, size_t max_events, int timeout_ms);
+
+#endif // ! WHISKER_LOOP_H
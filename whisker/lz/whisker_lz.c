@@ -0,0 +1,234 @@
+#include "whisker_lz.h"
+
+#include <assert.h>
+#include <string.h>
+
+#define WHISKER_LZ_MIN_MATCH 4
+#define WHISKER_LZ_HASH_BITS 13
+#define WHISKER_LZ_SKIP_SHIFT 6
+
+// The match finder stops this far from the end, so reading four bytes ahead always stays inside
+#define WHISKER_LZ_TAIL 8
+
+static inline uint32_t whisker_lz_read32(const uint8_t* p) {
+    uint32_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+static inline uint64_t whisker_lz_read64(const uint8_t* p) {
+    uint64_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+static inline uint32_t whisker_lz_hash(uint32_t value) {
+    return (value * 2654435761u) >> (32 - WHISKER_LZ_HASH_BITS);
+}
+
+static inline uint8_t* whisker_lz_put_length(uint8_t* out, size_t length) {
+    while (length >= 255) {
+        *out++ = 255;
+        length -= 255;
+    }
+
+    *out++ = (uint8_t) length;
+    return out;
+}
+
+// Writes one sequence, NULL when it does not fit. A match length of 0 marks the last one.
+static uint8_t* whisker_lz_emit(uint8_t* out, const uint8_t* out_end, const uint8_t* literals, size_t literal_count, size_t match_length, size_t offset) {
+    const size_t match_extra = match_length != 0 ? match_length - WHISKER_LZ_MIN_MATCH : 0;
+
+    // Token, both length extensions, the literals and the offset
+    const size_t worst = 1 + literal_count / 255 + 1 + literal_count + match_extra / 255 + 1 + 2;
+    if ((size_t) (out_end - out) < worst) return NULL;
+
+    uint8_t* token = out++;
+    *token = (uint8_t) ((literal_count < 15 ? literal_count : 15) << 4);
+
+    if (literal_count >= 15) {
+        out = whisker_lz_put_length(out, literal_count - 15);
+    }
+
+    memcpy(out, literals, literal_count);
+    out += literal_count;
+
+    if (match_length == 0) return out;
+
+    *out++ = (uint8_t) offset;
+    *out++ = (uint8_t) (offset >> 8);
+
+    *token |= (uint8_t) (match_extra < 15 ? match_extra : 15);
+
+    if (match_extra >= 15) {
+        out = whisker_lz_put_length(out, match_extra - 15);
+    }
+
+    return out;
+}
+
+size_t whisker_lz_bound(size_t size) {
+    return size + size / 255 + 16;
+}
+
+size_t whisker_lz_compress(const void* source, size_t size, void* destination, size_t capacity) {
+    assert(size <= WHISKER_LZ_BLOCK);
+
+    const uint8_t* src = source;
+    const uint8_t* end = src + size;
+    const uint8_t* anchor = src;
+    const uint8_t* ip = src;
+
+    uint8_t* out = destination;
+    const uint8_t* out_end = out + capacity;
+
+    if (size > WHISKER_LZ_TAIL + WHISKER_LZ_MIN_MATCH) {
+        // Positions only, a stale or colliding entry is caught by comparing the bytes
+        uint16_t table[1 << WHISKER_LZ_HASH_BITS];
+        memset(table, 0, sizeof(table));
+
+        const uint8_t* limit = end - WHISKER_LZ_TAIL;
+        ip++;
+
+        while (ip < limit) {
+            const uint32_t value = whisker_lz_read32(ip);
+            const uint32_t slot = whisker_lz_hash(value);
+            const uint8_t* ref = src + table[slot];
+
+            table[slot] = (uint16_t) (ip - src);
+
+            if (ref >= ip || whisker_lz_read32(ref) != value) {
+                ip += 1 + ((size_t) (ip - anchor) >> WHISKER_LZ_SKIP_SHIFT);
+                continue;
+            }
+
+            // Grow the match backwards into the pending literals, then forwards
+            while (ip > anchor && ref > src && ip[-1] == ref[-1]) {
+                ip--;
+                ref--;
+            }
+
+            const uint8_t* match_end = ip + WHISKER_LZ_MIN_MATCH;
+            const uint8_t* ref_end = ref + WHISKER_LZ_MIN_MATCH;
+
+            // Eight bytes at a time, the first differing byte is the lowest set one (little endian)
+            while (match_end + 8 <= end) {
+                const uint64_t diff = whisker_lz_read64(match_end) ^ whisker_lz_read64(ref_end);
+
+                if (diff != 0) {
+                    match_end += __builtin_ctzll(diff) >> 3;
+                    goto matched;
+                }
+
+                match_end += 8;
+                ref_end += 8;
+            }
+
+            while (match_end < end && *match_end == *ref_end) {
+                match_end++;
+                ref_end++;
+            }
+
+        matched:
+            out = whisker_lz_emit(out, out_end, anchor, (size_t) (ip - anchor), (size_t) (match_end - ip), (size_t) (ip - ref));
+            if (out == NULL) return 0;
+
+            ip = match_end;
+            anchor = ip;
+
+            // The position just before the next search is likely to start the following match
+            if (ip < limit) {
+                table[whisker_lz_hash(whisker_lz_read32(ip - 2))] = (uint16_t) (ip - 2 - src);
+            }
+        }
+    }
+
+    out = whisker_lz_emit(out, out_end, anchor, (size_t) (end - anchor), 0, 0);
+    if (out == NULL) return 0;
+
+    return (size_t) (out - (uint8_t*) destination);
+}
+
+static inline bool whisker_lz_get_length(const uint8_t** ip, const uint8_t* end, size_t* length) {
+    uint8_t byte;
+
+    do {
+        if (*ip >= end) return false;
+
+        byte = *(*ip)++;
+        *length += byte;
+    } while (byte == 255);
+
+    return true;
+}
+
+bool whisker_lz_decompress(const void* source, size_t source_size, void* destination, size_t size) {
+    const uint8_t* ip = source;
+    const uint8_t* end = ip + source_size;
+
+    uint8_t* dst = destination;
+    uint8_t* op = dst;
+    const uint8_t* out_end = dst + size;
+
+    while (ip < end) {
+        const uint8_t token = *ip++;
+        size_t literal_count = token >> 4;
+
+        // Short literals are moved as one fixed 16 byte chunk while both buffers have room for it,
+        // the bytes past the count are overwritten by what follows
+        if (literal_count != 15 && end - ip >= 16 && out_end - op >= 16) {
+            memcpy(op, ip, 16);
+        } else {
+            if (literal_count == 15 && !whisker_lz_get_length(&ip, end, &literal_count)) return false;
+            if (literal_count > (size_t) (end - ip) || literal_count > (size_t) (out_end - op)) return false;
+
+            memcpy(op, ip, literal_count);
+        }
+
+        op += literal_count;
+        ip += literal_count;
+
+        if (ip == end) break;
+        if (end - ip < 2) return false;
+
+        const size_t offset = (size_t) ip[0] | (size_t) ip[1] << 8;
+        ip += 2;
+
+        size_t match_length = token & 15;
+
+        if (match_length == 15 && !whisker_lz_get_length(&ip, end, &match_length)) return false;
+        match_length += WHISKER_LZ_MIN_MATCH;
+
+        if (offset == 0 || offset > (size_t) (op - dst) || match_length > (size_t) (out_end - op)) return false;
+
+        const uint8_t* ref = op - offset;
+
+        // Same for short matches, the second chunk only reads bytes the first one wrote
+        if (match_length <= 32 && offset >= 16 && out_end - op >= 32) {
+            memcpy(op, ref, 16);
+            memcpy(op + 16, ref + 16, 16);
+        } else if (offset >= match_length) {
+            memcpy(op, ref, match_length);
+        } else if (offset >= 8) {
+            // Overlapping, but every 8 byte chunk reads bytes that were already written
+            size_t i = 0;
+
+            for (; i + 8 <= match_length; i += 8) {
+                memcpy(op + i, ref + i, 8);
+            }
+
+            for (; i < match_length; i++) {
+                op[i] = ref[i];
+            }
+        } else {
+            for (size_t i = 0; i < match_length; i++) {
+                op[i] = ref[i];
+            }
+        }
+
+        op += match_length;
+    }
+
+    return op == out_end;
+}
@@ -0,0 +1,41 @@
+#ifndef WHISKER_LZ_H
+#define WHISKER_LZ_H
+
+#ifdef WHISKER_NOPREFIX
+    #define lz_bound whisker_lz_bound
+    #define lz_compress whisker_lz_compress
+    #define lz_decompress whisker_lz_decompress
+#endif
+
+/*
+ *  Byte oriented LZ77 block codec, built for decode speed over ratio
+ *
+ *      A block is a run of sequences: a token byte holding a literal count and a match length
+ *      in its two nibbles, extra length bytes when a nibble is 15, the literals and a two byte
+ *      little endian match offset. The last sequence has literals only and ends the block.
+ *
+ *      Blocks are independent and at most WHISKER_LZ_BLOCK bytes, so every offset fits in 16
+ *      bits and the match finder's table holds 16 bit positions. Matches are found greedily
+ *      through a hash of the next four bytes, and the step grows while nothing matches, so
+ *      incompressible data passes through quickly.
+ *
+ *      The decoder checks every length and offset against both buffers, a corrupt block is
+ *      reported and never read or written out of bounds.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define WHISKER_LZ_BLOCK 65536
+
+// Worst case compressed size of 'size' bytes
+size_t whisker_lz_bound(size_t size);
+
+// Compressed size, or 0 when the result would not fit 'capacity'
+size_t whisker_lz_compress(const void* source, size_t size, void* destination, size_t capacity);
+
+// True only when the block decodes to exactly 'size' bytes
+bool whisker_lz_decompress(const void* source, size_t source_size, void* destination, size_t size);
+
+#endif // !WHISKER_LZ_H
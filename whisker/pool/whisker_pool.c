@@ -0,0 +1,183 @@
+#include "whisker_pool.h"
+
+#include <assert.h>
+#include <stdlib.h>
+
+static void whisker_pool_run(Whisker_Pool* pool, Whisker_Task task, void* context, size_t count) {
+    size_t index;
+
+    while ((index = __atomic_fetch_add(&pool -> next, 1, __ATOMIC_RELAXED)) < count) {
+        task(context, index);
+    }
+}
+
+static void* whisker_pool_worker(void* arg) {
+    Whisker_Pool* pool = arg;
+    uint64_t seen = 0;
+
+    pthread_mutex_lock(&pool -> lock);
+
+    while (true) {
+        while (!pool -> stopping && pool -> generation == seen && pool -> queue_count == 0) {
+            pthread_cond_wait(&pool -> wake, &pool -> lock);
+        }
+
+        // Loops come first, the caller is blocked on them
+        if (pool -> generation == seen) {
+            if (pool -> queue_count == 0) break;
+
+            const Whisker_Queued queued = pool -> queue[pool -> queue_head];
+            pool -> queue_head = (pool -> queue_head + 1) % pool -> queue_capacity;
+            pool -> queue_count--;
+
+            pthread_mutex_unlock(&pool -> lock);
+            queued.task(queued.context, queued.index);
+            pthread_mutex_lock(&pool -> lock);
+            continue;
+        }
+
+        seen = pool -> generation;
+
+        const Whisker_Task task = pool -> task;
+        void* context = pool -> context;
+        const size_t count = pool -> count;
+
+        pthread_mutex_unlock(&pool -> lock);
+        whisker_pool_run(pool, task, context, count);
+        pthread_mutex_lock(&pool -> lock);
+
+        if (--pool -> busy == 0) {
+            pthread_cond_signal(&pool -> done);
+        }
+    }
+
+    pthread_mutex_unlock(&pool -> lock);
+    return NULL;
+}
+
+bool whisker_pool_init(Whisker_Pool* pool, size_t threads) {
+    assert(pool);
+
+    pool -> threads = NULL;
+    pool -> thread_count = 0;
+    pool -> task = NULL;
+    pool -> context = NULL;
+    pool -> count = 0;
+    pool -> next = 0;
+    pool -> busy = 0;
+    pool -> generation = 0;
+    pool -> queue = NULL;
+    pool -> queue_head = 0;
+    pool -> queue_count = 0;
+    pool -> queue_capacity = 0;
+    pool -> stopping = false;
+
+    pthread_mutex_init(&pool -> lock, NULL);
+    pthread_cond_init(&pool -> wake, NULL);
+    pthread_cond_init(&pool -> done, NULL);
+
+    if (threads <= 1) return true;
+
+    pool -> threads = malloc(sizeof(pthread_t) * (threads - 1));
+    if (pool -> threads == NULL) return false;
+
+    // Whatever could be started is used, with no workers at all loops simply run on the caller
+    for (size_t i = 0; i < threads - 1; i++) {
+        if (pthread_create(&pool -> threads[i], NULL, whisker_pool_worker, pool) != 0) break;
+        pool -> thread_count++;
+    }
+
+    return pool -> thread_count == threads - 1;
+}
+
+void whisker_pool_destroy(Whisker_Pool* pool) {
+    pthread_mutex_lock(&pool -> lock);
+    pool -> stopping = true;
+    pthread_cond_broadcast(&pool -> wake);
+    pthread_mutex_unlock(&pool -> lock);
+
+    for (size_t i = 0; i < pool -> thread_count; i++) {
+        pthread_join(pool -> threads[i], NULL);
+    }
+
+    free(pool -> threads);
+    pool -> threads = NULL;
+    pool -> thread_count = 0;
+
+    free(pool -> queue);
+    pool -> queue = NULL;
+
+    pthread_cond_destroy(&pool -> done);
+    pthread_cond_destroy(&pool -> wake);
+    pthread_mutex_destroy(&pool -> lock);
+}
+
+void whisker_pool_for(Whisker_Pool* pool, size_t count, Whisker_Task task, void* context) {
+    if (count == 0) return;
+
+    if (pool -> thread_count == 0 || count == 1) {
+        for (size_t i = 0; i < count; i++) {
+            task(context, i);
+        }
+
+        return;
+    }
+
+    // Every worker takes part in every loop, so none can still be draining the previous one
+    pthread_mutex_lock(&pool -> lock);
+    pool -> task = task;
+    pool -> context = context;
+    pool -> count = count;
+    pool -> next = 0;
+    pool -> busy = pool -> thread_count;
+    pool -> generation++;
+    pthread_cond_broadcast(&pool -> wake);
+    pthread_mutex_unlock(&pool -> lock);
+
+    whisker_pool_run(pool, task, context, count);
+
+    pthread_mutex_lock(&pool -> lock);
+
+    while (pool -> busy > 0) {
+        pthread_cond_wait(&pool -> done, &pool -> lock);
+    }
+
+    pthread_mutex_unlock(&pool -> lock);
+}
+
+bool whisker_pool_submit(Whisker_Pool* pool, Whisker_Task task, void* context, size_t index) {
+    if (pool -> thread_count == 0) {
+        task(context, index);
+        return true;
+    }
+
+    pthread_mutex_lock(&pool -> lock);
+
+    if (pool -> queue_count == pool -> queue_capacity) {
+        const size_t capacity = pool -> queue_capacity != 0 ? pool -> queue_capacity * 2 : 64;
+        Whisker_Queued* queue = malloc(sizeof(Whisker_Queued) * capacity);
+
+        if (queue == NULL) {
+            pthread_mutex_unlock(&pool -> lock);
+            return false;
+        }
+
+        // Unrolled so the ring starts at 0 again
+        for (size_t i = 0; i < pool -> queue_count; i++) {
+            queue[i] = pool -> queue[(pool -> queue_head + i) % pool -> queue_capacity];
+        }
+
+        free(pool -> queue);
+        pool -> queue = queue;
+        pool -> queue_head = 0;
+        pool -> queue_capacity = capacity;
+    }
+
+    pool -> queue[(pool -> queue_head + pool -> queue_count) % pool -> queue_capacity] = (Whisker_Queued) { task, context, index };
+    pool -> queue_count++;
+
+    pthread_cond_signal(&pool -> wake);
+    pthread_mutex_unlock(&pool -> lock);
+
+    return true;
+}
@@ -0,0 +1,64 @@
+#ifndef WHISKER_POOL_H
+#define WHISKER_POOL_H
+
+#ifdef WHISKER_NOPREFIX
+    #define pool_init whisker_pool_init
+    #define pool_destroy whisker_pool_destroy
+    #define pool_for whisker_pool_for
+    #define pool_submit whisker_pool_submit
+#endif
+
+/*
+ *  Fixed set of worker threads for data parallel loops
+ *
+ *      whisker_pool_for() hands out the indices of a loop one at a time through a shared
+ *      counter, so slow items (a large file among headers) do not hold up a whole chunk.
+ *      The calling thread works through indices as well and the call returns once every
+ *      worker is done with the loop.
+ *
+ *      whisker_pool_submit() queues a single call and returns right away, it is up to the task
+ *      to report back (a pipe or eventfd the caller polls, say). Queued calls run in order.
+ */
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef void (*Whisker_Task)(void* context, size_t index);
+
+typedef struct {
+    Whisker_Task task;
+    void* context;
+    size_t index;
+} Whisker_Queued;
+
+typedef struct {
+    pthread_t* threads;
+    size_t thread_count;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    pthread_cond_t done;
+    Whisker_Task task;
+    void* context;
+    size_t count;
+    size_t next;
+    size_t busy;
+    uint64_t generation;
+    Whisker_Queued* queue;
+    size_t queue_head;
+    size_t queue_count;
+    size_t queue_capacity;
+    bool stopping;
+} Whisker_Pool;
+
+// Starts threads - 1 workers, the caller is the last thread
+bool whisker_pool_init(Whisker_Pool* pool, size_t threads);
+void whisker_pool_destroy(Whisker_Pool* pool);
+
+void whisker_pool_for(Whisker_Pool* pool, size_t count, Whisker_Task task, void* context);
+
+// Without workers the task runs before this returns. False when the queue cannot grow.
+bool whisker_pool_submit(Whisker_Pool* pool, Whisker_Task task, void* context, size_t index);
+
+#endif // !WHISKER_POOL_H